@@ -1,10 +1,52 @@
 import socket
+import struct
 import numpy as np
 import cv2
 import time
 
+# frame header of general_post before every payload, little endian
+FRAME_HEADER = struct.Struct("<IHHIHHQIHH")
+FRAME_MAGIC = 0x46474553
+FRAME_VERSION = 1
+ENCODING_IMAGE = 1
+ENCODING_STRIPE = 2
+ENCODING_POLYGON = 3
+ENCODING_FREESPACE = 4
+ENCODING_BEV = 5
+
+# stripe header of general_post stripe_rows mode, little endian
+STRIPE_HEADER = struct.Struct("<IIHHHHI")
+STRIPE_MAGIC = 0x50525453
+
+# polygon record of general_post output_format polygon, then int16 x, y
+POLYGON_HEADER = struct.Struct("<IIHHHHI")
+POLYGON_MAGIC = 0x594C4F50
+
+# free space record of general_post output_format freespace, then uint16
+# boundary per column and uint8 confidence per column if flags bit 0
+FREESPACE_HEADER = struct.Struct("<IIHHHHI")
+FREESPACE_MAGIC = 0x45455246
+
+# bird's-eye-view record of general_post output_format bev, then 8-bit
+# road level per cell
+BEV_HEADER = struct.Struct("<IIHHHHI")
+BEV_MAGIC = 0x47564542
+
+class Payload:
+    # payload of one frame, read like a socket by the record parsers
+    def __init__(self, data):
+        self.data = memoryview(data)
+        self.offset = 0
+
+    def recv(self, size):
+        chunk = self.data[self.offset:self.offset + size]
+        self.offset += len(chunk)
+        return bytes(chunk)
+
 class Server:
-    buf_size = 623*188*3
+    width = 623
+    height = 188
+    stripe_frame = None
     start_time = 0
     read_num = 0
     fps = 0
@@ -14,16 +56,26 @@ class Server:
         server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
         server.bind(('192.168.1.134', 4097))
         server.listen()
-        print("wait connect...")
-        conn, addr = server.accept()
-        print("connected, ", addr)
-        print("wait info...")
         cv2.namedWindow("img", cv2.WINDOW_NORMAL)
         cv2.resizeWindow("img", 1246, 376)
         font = cv2.FONT_HERSHEY_SIMPLEX
         count = 200
+        conn = None
         while count:
-            stringData = self.recv_size(conn, self.buf_size)
+            if conn is None:
+                print("wait connect...")
+                conn, addr = server.accept()
+                print("connected, ", addr)
+                # subscribe to the overlay, general_post overlay_on_demand
+                # waits for it
+                conn.sendall(b"O")
+                self.stripe_frame = None
+            stringData = self.recv_image(conn)
+            if stringData is None:
+                # general_post reconnects with backoff, wait for it
+                conn.close()
+                conn = None
+                continue
             self.read_num += 1
             if count==200:
                 self.start_time = time.time()
@@ -36,19 +88,145 @@ class Server:
                 self.start_time = time.time()
             # data convert
             data = np.frombuffer(stringData, np.uint8)
-            data = data.reshape(188,623,3)
+            data = data.reshape(self.height, self.width, 3)
             msg_num = "{:3d}/200".format((200-count))
             msg_fps = "FPS: {:>4.2f}".format(self.fps)
-            img = cv2.putText(data, msg_num, (530, 15), font, 0.5, (0, 0, 255), 1)
-            img = cv2.putText(img, msg_fps, (530, 30), font, 0.5, (0, 0, 255), 1)
+            img = cv2.putText(data, msg_num, (self.width - 93, 15), font, 0.5, (0, 0, 255), 1)
+            img = cv2.putText(img, msg_fps, (self.width - 93, 30), font, 0.5, (0, 0, 255), 1)
             cv2.imshow("img", data)
             cv2.waitKey(10)
             count -= 1
 
-        conn.close()
+        if conn is not None:
+            conn.close()
         server.close()
         print("closed")
 
+    def recv_frame(self, sokt):
+        header = self.recv_size(sokt, FRAME_HEADER.size)
+        if header is None:
+            return None
+        magic, version, encoding, frame_id, width, height, timestamp_us, \
+            size, flags, _ = FRAME_HEADER.unpack(header)
+        if magic != FRAME_MAGIC or version != FRAME_VERSION:
+            print("bad frame magic or version, ", hex(magic), version)
+            return None
+        payload = self.recv_size(sokt, size)
+        if payload is None:
+            return None
+        return encoding, width, height, payload
+
+    def recv_image(self, sokt):
+        # image to show of the next complete frame, whatever its encoding
+        while True:
+            frame = self.recv_frame(sokt)
+            if frame is None:
+                return None
+            encoding, width, height, payload = frame
+            if encoding == ENCODING_IMAGE:
+                self.width, self.height = width, height
+                return payload
+            if encoding == ENCODING_STRIPE:
+                image = self.recv_stripe(Payload(payload))
+                if image is not None:
+                    return image
+            elif encoding == ENCODING_POLYGON:
+                return self.recv_polygon(Payload(payload))
+            elif encoding == ENCODING_FREESPACE:
+                return self.recv_freespace(Payload(payload))
+            elif encoding == ENCODING_BEV:
+                return self.recv_bev(Payload(payload))
+
+    def recv_stripe(self, sokt):
+        # assemble stripes in place, frame is complete with its last stripe
+        header = self.recv_size(sokt, STRIPE_HEADER.size)
+        if header is None:
+            return None
+        magic, frame_id, width, height, row, rows, size = \
+            STRIPE_HEADER.unpack(header)
+        if magic != STRIPE_MAGIC:
+            print("bad stripe magic, ", hex(magic))
+            return None
+        payload = self.recv_size(sokt, size)
+        if payload is None:
+            return None
+        # stripes carry the frame size, road region or full frame
+        if self.stripe_frame is None \
+                or (width, height) != (self.width, self.height):
+            self.width, self.height = width, height
+            self.stripe_frame = bytearray(width * height * 3)
+        offset = row * width * 3
+        self.stripe_frame[offset:offset + size] = payload
+        if row + rows >= height:
+            return bytes(self.stripe_frame)
+        return None
+
+    def recv_polygon(self, sokt):
+        # draw the road polygon filled on a black image of output size
+        header = self.recv_size(sokt, POLYGON_HEADER.size)
+        if header is None:
+            return None
+        magic, frame_id, width, height, points, _, area = \
+            POLYGON_HEADER.unpack(header)
+        if magic != POLYGON_MAGIC:
+            print("bad polygon magic, ", hex(magic))
+            return None
+        self.width, self.height = width, height
+        img = np.zeros((height, width, 3), np.uint8)
+        if points > 0:
+            payload = self.recv_size(sokt, points * 4)
+            if payload is None:
+                return None
+            xy = np.frombuffer(payload, np.int16).reshape(-1, 1, 2)
+            cv2.fillPoly(img, [xy.astype(np.int32)], (255, 0, 255))
+            cv2.polylines(img, [xy.astype(np.int32)], True, (255, 255, 255), 1)
+        return img.tobytes()
+
+    def recv_freespace(self, sokt):
+        # draw free space of each column from its boundary down
+        header = self.recv_size(sokt, FREESPACE_HEADER.size)
+        if header is None:
+            return None
+        magic, frame_id, width, height, flags, _, size = \
+            FREESPACE_HEADER.unpack(header)
+        if magic != FREESPACE_MAGIC:
+            print("bad free space magic, ", hex(magic))
+            return None
+        payload = self.recv_size(sokt, size)
+        if payload is None:
+            return None
+        self.width, self.height = width, height
+        boundary = np.frombuffer(payload, np.uint16, width)
+        img = np.zeros((height, width, 3), np.uint8)
+        rows = np.arange(height).reshape(-1, 1)
+        free = rows >= boundary.reshape(1, -1)
+        if flags & 1:
+            confidence = np.frombuffer(payload, np.uint8, width, width * 2)
+            img[:, :, 0] = np.where(free, confidence.reshape(1, -1), 0)
+        else:
+            img[:, :, 0] = np.where(free, 255, 0)
+        img[:, :, 2] = img[:, :, 0]
+        return img.tobytes()
+
+    def recv_bev(self, sokt):
+        # road level of each cell as magenta intensity
+        header = self.recv_size(sokt, BEV_HEADER.size)
+        if header is None:
+            return None
+        magic, frame_id, width, height, _, _, size = BEV_HEADER.unpack(header)
+        if magic != BEV_MAGIC:
+            print("bad bev magic, ", hex(magic))
+            return None
+        payload = self.recv_size(sokt, size)
+        if payload is None:
+            return None
+        self.width, self.height = width, height
+        cells = np.frombuffer(payload, np.uint8).reshape(height, width)
+        img = np.zeros((height, width, 3), np.uint8)
+        img[:, :, 0] = cells
+        img[:, :, 2] = cells
+        return img.tobytes()
+
     def recv_size(self, sokt, size):
         buf = b""
         while size:
@@ -60,5 +238,6 @@ class Server:
         return buf
 
 if __name__=="__main__":
+    # frames carry encoding and size, any output format of general_post
     server = Server()
     server.run()
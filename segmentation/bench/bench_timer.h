@@ -0,0 +1,62 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef BENCH_BENCH_TIMER_H_
+#define BENCH_BENCH_TIMER_H_
+
+#include <stdint.h>
+#include <chrono>
+
+/**
+ * @brief: best time of repeated runs in microseconds; the minimum is the
+ *         run least disturbed by other load on the host
+ * @param [in]: repeat: runs
+ * @param [in]: func: work of one run
+ */
+template <class Func>
+double BestOfUs(uint32_t repeat, const Func &func) {
+  double best = 0.0;
+  for (uint32_t run = 0; run < repeat; run++) {
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    func();
+    double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+    if (run == 0 || us < best) {
+      best = us;
+    }
+  }
+  return best;
+}
+
+#endif /* BENCH_BENCH_TIMER_H_ */
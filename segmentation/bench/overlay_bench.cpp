@@ -0,0 +1,205 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <random>
+#include <vector>
+
+#include "bench_timer.h"
+#include "overlay_kernel.h"
+
+/**
+ * @brief: overlay kernels against the scalar reference: bit-exact check
+ *         over small widths (every vector tail) and strides, then the
+ *         time of a 1280x720 overlay. A whole frame is memory bound, one
+ *         row blended over and over shows the kernel itself
+ */
+namespace {
+const uint32_t kCheckWidths = 300;
+const uint32_t kCheckStrides = 3;
+// output of the 640x360 model, full overlay upsamples it 2x
+const uint32_t kFrameWidth = 1280;
+const uint32_t kFrameHeight = 720;
+const uint32_t kRepeat = 50;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+const char *kKernel = "NEON";
+#elif defined(__AVX2__)
+const char *kKernel = "AVX2";
+#elif defined(__SSE2__)
+const char *kKernel = "SSE2";
+#else
+const char *kKernel = "scalar";
+#endif
+
+uint8_t Blend(uint32_t mask, uint32_t image) {
+  return static_cast<uint8_t>((overlay::kMaskWeight * mask
+      + overlay::kImageWeight * image + 128) >> 8);
+}
+
+/**
+ * @brief: scalar upsample of overlay.h, then the fixed point blend
+ */
+void UpsampledReference(const uint8_t *q_near, const uint8_t *q_far,
+                        uint8_t *row, uint32_t width) {
+  std::vector<uint32_t> column(width + 2);
+  for (uint32_t x = 0; x < width; x++) {
+    column[x + 1] = 3 * q_near[x] + q_far[x];
+  }
+  column[0] = column[1];
+  column[width + 1] = column[width];
+  for (uint32_t x = 0; x < width * 2; x++) {
+    uint32_t centre = 3 * column[x / 2 + 1];
+    uint32_t side = (x & 1) ? column[x / 2 + 2] : column[x / 2];
+    uint32_t q = (centre + side + 8) >> 4;
+    uint8_t *pixel = row + x * 3;
+    pixel[0] = Blend(q, pixel[0]);
+    pixel[2] = Blend(255 - q, pixel[2]);
+  }
+}
+
+/**
+ * @return: rows that differ from the reference
+ */
+uint32_t CheckRows(std::mt19937 &random) {
+  std::uniform_real_distribution<float> probability(-0.2f, 1.2f);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+  uint32_t mismatches = 0;
+  for (uint32_t width = 1; width < kCheckWidths; width++) {
+    for (uint32_t stride = 1; stride <= kCheckStrides; stride++) {
+      std::vector<float> prob(width * stride * 2);
+      for (float &value : prob) {
+        value = probability(random);
+      }
+      std::vector<uint8_t> image(width * 6);
+      for (uint8_t &value : image) {
+        value = static_cast<uint8_t>(byte(random));
+      }
+      std::vector<uint8_t> scratch(overlay::UpsampleScratchSize(width));
+      std::vector<uint8_t> expected(width * 3);
+      std::vector<uint8_t> actual(width * 3);
+      overlay::BlendRowReference(&prob[0], stride, &image[0], &expected[0],
+                                 width);
+      overlay::BlendRow(&prob[0], stride, &image[0], &actual[0], width,
+                        &scratch[0]);
+      mismatches += (actual != expected);
+      // in place, as the engine blends
+      actual.assign(image.begin(), image.begin() + width * 3);
+      overlay::BlendRow(&prob[0], stride, &actual[0], &actual[0], width,
+                        &scratch[0]);
+      mismatches += (actual != expected);
+
+      const float *far = &prob[width * stride];
+      std::vector<uint8_t> q_near(width);
+      std::vector<uint8_t> q_far(width);
+      overlay::ProbabilityToFixed(&prob[0], stride, &q_near[0], width);
+      overlay::ProbabilityToFixed(far, stride, &q_far[0], width);
+      std::vector<uint8_t> row(image);
+      UpsampledReference(&q_near[0], &q_far[0], &image[0], width);
+      overlay::BlendUpsampledRow(&prob[0], far, stride, &row[0], width,
+                                 &scratch[0]);
+      mismatches += (row != image);
+    }
+  }
+  return mismatches;
+}
+}
+
+int main() {
+  std::mt19937 random(7);
+  uint32_t mismatches = CheckRows(random);
+  printf("kernel %s, widths 1-%u, strides 1-%u: %u mismatching rows\n",
+         kKernel, kCheckWidths - 1, kCheckStrides, mismatches);
+
+  // model output at the frame size, two channels as the road model
+  uint32_t width = kFrameWidth;
+  uint32_t height = kFrameHeight;
+  std::uniform_real_distribution<float> probability(0.0f, 1.0f);
+  std::vector<float> prob(width * height * 2);
+  for (float &value : prob) {
+    value = probability(random);
+  }
+  std::vector<uint8_t> q(width * height);
+  overlay::ProbabilityToFixed(&prob[0], 2, &q[0], width * height);
+  std::vector<uint8_t> image(width * height * 3, 100);
+  std::vector<uint8_t> scratch(overlay::UpsampleScratchSize(width));
+  uint32_t step = width * 3;
+
+  double reference = BestOfUs(kRepeat, [&]() {
+    for (uint32_t y = 0; y < height; y++) {
+      overlay::BlendRowReference(&prob[y * width * 2], 2, &image[y * step],
+                                 &image[y * step], width);
+    }
+  });
+  double fixed = BestOfUs(kRepeat, [&]() {
+    for (uint32_t y = 0; y < height; y++) {
+      overlay::BlendFixedRow(&q[y * width], &image[y * step],
+                             &image[y * step], width);
+    }
+  });
+  double cached = BestOfUs(kRepeat, [&]() {
+    for (uint32_t y = 0; y < height; y++) {
+      overlay::BlendFixedRow(&q[0], &image[0], &image[0], width);
+    }
+  });
+  double row = BestOfUs(kRepeat, [&]() {
+    overlay::BlendImage(&prob[0], 2, &image[0], step, &image[0], step, width,
+                        height, &scratch[0]);
+  });
+  // mask of half the size, every row upsampled from its two nearest
+  uint32_t mask_width = width / 2;
+  uint32_t mask_height = height / 2;
+  double upsampled = BestOfUs(kRepeat, [&]() {
+    for (uint32_t y = 0; y < height; y++) {
+      uint32_t near = y / 2;
+      uint32_t far = near;
+      if ((y & 1) != 0 && near + 1 < mask_height) {
+        far = near + 1;
+      } else if ((y & 1) == 0 && near > 0) {
+        far = near - 1;
+      }
+      overlay::BlendUpsampledRow(&prob[near * mask_width * 2],
+                                 &prob[far * mask_width * 2], 2,
+                                 &image[y * step], mask_width, &scratch[0]);
+    }
+  });
+  printf("%ux%u, best of %u, us per frame:\n", width, height, kRepeat);
+  printf("  BlendRowReference  %8.0f\n", reference);
+  printf("  BlendImage         %8.0f  x%.2f\n", row, reference / row);
+  printf("  BlendFixedRow      %8.0f  (8-bit mask, blend only)\n", fixed);
+  printf("  BlendFixedRow      %8.0f  (one row in cache)\n", cached);
+  printf("  BlendUpsampledRow  %8.0f  (%ux%u mask)\n", upsampled, mask_width,
+         mask_height);
+  return mismatches == 0 ? 0 : 1;
+}
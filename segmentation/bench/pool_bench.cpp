@@ -0,0 +1,148 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench_timer.h"
+#include "color_kernel.h"
+#include "overlay_kernel.h"
+#include "worker_pool.h"
+
+/**
+ * @brief: scaling of the post row bands over post_threads 1..N: camera
+ *         frame conversion, overlay blend and both in one band as the
+ *         engine runs them. N is hardware_concurrency, or the first
+ *         argument to go past the cores
+ */
+namespace {
+const uint32_t kFrameWidth = 1280;
+const uint32_t kFrameHeight = 720;
+const uint32_t kRepeat = 30;
+const uint32_t kCacheLine = 64;
+
+struct Timing {
+  double convert;
+  double blend;
+  double both;
+};
+
+Timing Measure(WorkerPool &pool, const std::vector<uint8_t> &yuv,
+               const std::vector<float> &prob, std::vector<uint8_t> &image,
+               std::vector<uint8_t> &scratch, uint32_t scratch_stride) {
+  uint32_t width = kFrameWidth;
+  uint32_t height = kFrameHeight;
+  uint32_t step = width * 3;
+  Timing timing;
+  timing.convert = BestOfUs(kRepeat, [&]() {
+    pool.Run(height, step, [&](uint32_t, uint32_t begin, uint32_t end) {
+      color::Nv21RowsToRgb(&yuv[0], width, height, begin, end - begin,
+                           &image[begin * step], step);
+    });
+  });
+  timing.blend = BestOfUs(kRepeat, [&]() {
+    pool.Run(height, step, [&](uint32_t worker, uint32_t begin,
+                               uint32_t end) {
+      overlay::BlendImage(&prob[begin * width * 2], 2, &image[begin * step],
+                          step, &image[begin * step], step, width,
+                          end - begin, &scratch[worker * scratch_stride]);
+    });
+  });
+  // rows converted and blended while in cache
+  timing.both = BestOfUs(kRepeat, [&]() {
+    pool.Run(height, step, [&](uint32_t worker, uint32_t begin,
+                               uint32_t end) {
+      color::Nv21RowsToRgb(&yuv[0], width, height, begin, end - begin,
+                           &image[begin * step], step);
+      overlay::BlendImage(&prob[begin * width * 2], 2, &image[begin * step],
+                          step, &image[begin * step], step, width,
+                          end - begin, &scratch[worker * scratch_stride]);
+    });
+  });
+  return timing;
+}
+}
+
+int main(int argc, char **argv) {
+  uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  uint32_t max_threads = cores;
+  if (argc > 1) {
+    int32_t threads = atoi(argv[1]);
+    if (threads <= 0) {
+      fprintf(stderr, "usage: %s [max threads]\n", argv[0]);
+      return 1;
+    }
+    max_threads = static_cast<uint32_t>(threads);
+  }
+
+  uint32_t width = kFrameWidth;
+  uint32_t height = kFrameHeight;
+  std::mt19937 random(7);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+  std::vector<uint8_t> yuv(width * height * 3 / 2);
+  for (uint8_t &value : yuv) {
+    value = static_cast<uint8_t>(byte(random));
+  }
+  std::uniform_real_distribution<float> probability(0.0f, 1.0f);
+  std::vector<float> prob(width * height * 2);
+  for (float &value : prob) {
+    value = probability(random);
+  }
+  std::vector<uint8_t> image(width * height * 3);
+  uint32_t scratch_stride = (overlay::ScratchSize(width) + kCacheLine - 1)
+      / kCacheLine * kCacheLine;
+  std::vector<uint8_t> scratch(scratch_stride * max_threads);
+
+  printf("%ux%u, %u cores, best of %u, us per frame (speedup):\n", width,
+         height, cores, kRepeat);
+  printf("threads    Nv21RowsToRgb        BlendImage   convert + blend\n");
+  Timing single = {0.0, 0.0, 0.0};
+  for (uint32_t threads = 1; threads <= max_threads; threads++) {
+    std::unique_ptr<WorkerPool> pool(new WorkerPool(threads));
+    Timing timing = Measure(*pool, yuv, prob, image, scratch, scratch_stride);
+    if (threads == 1) {
+      single = timing;
+    }
+    printf("%7u %9.0f (x%.2f) %9.0f (x%.2f) %9.0f (x%.2f)%s\n",
+           pool->Threads(), timing.convert, single.convert / timing.convert,
+           timing.blend, single.blend / timing.blend, timing.both,
+           single.both / timing.both, threads > cores ? "  over cores" : "");
+  }
+  return 0;
+}
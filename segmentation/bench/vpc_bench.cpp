@@ -0,0 +1,178 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench_timer.h"
+#include "opencv2/opencv.hpp"
+#include "vpc_kernel.h"
+
+/**
+ * @brief: vpc::CropResize against OpenCV on a 1280x720 frame to the
+ *         default model size, BGR (picture mode) and NV12 (camera) input.
+ *         OpenCV runs on one thread like the kernel. The NV12 output of
+ *         both is compared, bilinear with half pixel centres on both
+ *         sides, so only rounding differs
+ */
+namespace {
+const uint32_t kSrcWidth = 1280;
+const uint32_t kSrcHeight = 720;
+// default model_size 623x188, VPC takes the even part
+const uint32_t kDstWidth = 622;
+const uint32_t kDstHeight = 188;
+const uint32_t kRepeat = 30;
+
+/**
+ * @brief: planar I420 of cvtColor to the interleaved NV12 of VPC
+ */
+void I420ToNv12(const cv::Mat &i420, uint32_t width, uint32_t height,
+                uint8_t *nv12) {
+  const uint8_t *y_plane = i420.data;
+  const uint8_t *u_plane = y_plane + width * height;
+  const uint8_t *v_plane = u_plane + width * height / 4;
+  memcpy(nv12, y_plane, width * height);
+  uint8_t *uv = nv12 + width * height;
+  for (uint32_t i = 0; i < width * height / 4; i++) {
+    uv[i * 2] = u_plane[i];
+    uv[i * 2 + 1] = v_plane[i];
+  }
+}
+
+/**
+ * @brief: mean and max absolute difference
+ */
+void Difference(const uint8_t *a, const uint8_t *b, uint32_t count,
+                double &mean, uint32_t &max) {
+  uint64_t total = 0;
+  max = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t diff = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    total += diff;
+    max = diff > max ? diff : max;
+  }
+  mean = static_cast<double>(total) / count;
+}
+
+void Report(const char *name, double kernel_us, double opencv_us) {
+  printf("  %-34s %8.0f %8.0f  x%.2f\n", name, kernel_us, opencv_us,
+         opencv_us / kernel_us);
+}
+}
+
+int main() {
+  cv::setNumThreads(1);
+  uint32_t width = kSrcWidth;
+  uint32_t height = kSrcHeight;
+  // smooth gradients with a fine pattern, so resampling errors show
+  std::vector<uint8_t> bgr(width * height * 3);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t *pixel = &bgr[(y * width + x) * 3];
+      pixel[0] = static_cast<uint8_t>(x * 255 / width);
+      pixel[1] = static_cast<uint8_t>(y * 255 / height);
+      pixel[2] = static_cast<uint8_t>(((x / 4 + y / 4) & 1) ? 200 : 40);
+    }
+  }
+  std::vector<uint8_t> nv12(vpc::OutputSize(width, height));
+  vpc::BgrToNv12(&bgr[0], width, height, &nv12[0]);
+
+  vpc::CropRegion crop = { 0, 0, width - 1, height - 1 };
+  uint32_t dst_size = vpc::OutputSize(kDstWidth, kDstHeight);
+  std::vector<uint8_t> kernel_out(dst_size);
+  std::vector<uint8_t> opencv_out(dst_size);
+  cv::Size dst_shape(kDstWidth, kDstHeight);
+
+  printf("%ux%u to %ux%u NV12, best of %u, us per frame:\n", width, height,
+         kDstWidth, kDstHeight, kRepeat);
+  printf("  %-34s %8s %8s  %s\n", "input, OpenCV path", "vpc", "OpenCV",
+         "vpc speedup");
+
+  // BGR: resize, then colour conversion
+  vpc::SrcImage bgr_src = { &bgr[0], vpc::kInputBgr, width, height,
+      width * 3, height };
+  double kernel_bgr = BestOfUs(kRepeat, [&]() {
+    vpc::CropResize(bgr_src, crop, kDstWidth, kDstHeight, &kernel_out[0]);
+  });
+  cv::Mat bgr_mat(height, width, CV_8UC3, &bgr[0]);
+  cv::Mat small;
+  cv::Mat i420;
+  double opencv_bgr = BestOfUs(kRepeat, [&]() {
+    cv::resize(bgr_mat, small, dst_shape, 0, 0, cv::INTER_LINEAR);
+    cv::cvtColor(small, i420, cv::COLOR_BGR2YUV_I420);
+    I420ToNv12(i420, kDstWidth, kDstHeight, &opencv_out[0]);
+  });
+  Report("BGR, resize + BGR2YUV_I420", kernel_bgr, opencv_bgr);
+  double bgr_mean = 0.0;
+  uint32_t bgr_max = 0;
+  Difference(&kernel_out[0], &opencv_out[0], dst_size, bgr_mean, bgr_max);
+
+  // NV12: OpenCV resizes the planes, or goes through BGR
+  vpc::SrcImage nv12_src = { &nv12[0], vpc::kInputNv12, width, height,
+      width, height };
+  double kernel_nv12 = BestOfUs(kRepeat, [&]() {
+    vpc::CropResize(nv12_src, crop, kDstWidth, kDstHeight, &kernel_out[0]);
+  });
+  cv::Mat y_src(height, width, CV_8UC1, &nv12[0]);
+  cv::Mat uv_src(height / 2, width / 2, CV_8UC2, &nv12[width * height]);
+  cv::Mat y_dst(kDstHeight, kDstWidth, CV_8UC1, &opencv_out[0]);
+  cv::Mat uv_dst(kDstHeight / 2, kDstWidth / 2, CV_8UC2,
+                 &opencv_out[kDstWidth * kDstHeight]);
+  double opencv_planes = BestOfUs(kRepeat, [&]() {
+    cv::resize(y_src, y_dst, dst_shape, 0, 0, cv::INTER_LINEAR);
+    cv::resize(uv_src, uv_dst, cv::Size(kDstWidth / 2, kDstHeight / 2), 0,
+               0, cv::INTER_LINEAR);
+  });
+  Report("NV12, resize Y and UV planes", kernel_nv12, opencv_planes);
+  double nv12_mean = 0.0;
+  uint32_t nv12_max = 0;
+  Difference(&kernel_out[0], &opencv_out[0], dst_size, nv12_mean, nv12_max);
+
+  cv::Mat nv12_mat(height * 3 / 2, width, CV_8UC1, &nv12[0]);
+  cv::Mat frame;
+  std::vector<uint8_t> converted(dst_size);
+  double opencv_colour = BestOfUs(kRepeat, [&]() {
+    cv::cvtColor(nv12_mat, frame, cv::COLOR_YUV2BGR_NV12);
+    cv::resize(frame, small, dst_shape, 0, 0, cv::INTER_LINEAR);
+    cv::cvtColor(small, i420, cv::COLOR_BGR2YUV_I420);
+    I420ToNv12(i420, kDstWidth, kDstHeight, &converted[0]);
+  });
+  Report("NV12, YUV2BGR_NV12 + resize + I420", kernel_nv12, opencv_colour);
+
+  printf("output against OpenCV: BGR mean %.3f max %u, NV12 planes mean "
+         "%.3f max %u\n", bgr_mean, bgr_max, nv12_mean, nv12_max);
+  return 0;
+}
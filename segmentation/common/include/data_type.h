@@ -68,6 +68,8 @@ struct ImageInfo {
   int32_t height = 0; // original height
   int32_t size = 0; // data size
   int32_t mode = 0; // 0 cap, 1 pic
+  bool preprocessed = false; // cropped and resized to model size on host
+  int64_t timestamp_us = 0; // capture time, host steady clock
   std::shared_ptr<u_int8_t> data;
 };
 
@@ -80,6 +82,9 @@ void serialize(Archive& ar, ImageInfo& data) {
   ar(data.width);
   ar(data.height);
   ar(data.size);
+  ar(data.mode);
+  ar(data.preprocessed);
+  ar(data.timestamp_us);
   if (data.size > 0 && data.data.get() == nullptr) {
     data.data.reset(new u_int8_t[data.size]);
   }
@@ -106,6 +111,23 @@ void serialize(Archive& ar, Output& data) {
   ar(cereal::binary_data(data.data.get(), data.size * sizeof(u_int8_t)));
 }
 
+/**
+ * @brief: output tensor dimensions, as the model reports them at Init
+ */
+struct OutputDims {
+  uint32_t channels = 0;
+  uint32_t height = 0;
+  uint32_t width = 0;
+};
+
+/**
+ * @brief: serialize for OutputDims
+ */
+template<class Archive>
+void serialize(Archive& ar, OutputDims& data) {
+  ar(data.channels, data.height, data.width);
+}
+
 /**
  * @brief: Inference engine error message
  */
@@ -131,6 +153,10 @@ struct EngineTrans {
   ErrorInferenceMsg err_msg;
   std::vector<Output> inference_res;
   bool is_finished = false;
+  // output of the model producing inference_res, 0 if unknown
+  OutputDims output_dims;
+  // output of the full resolution model, shape of post-processing
+  OutputDims full_dims;
 };
 
 /**
@@ -139,9 +165,18 @@ struct EngineTrans {
 template<class Archive>
 void serialize(Archive& ar, EngineTrans& data) {
   ar(data.console_params, data.image_info, data.err_msg, data.inference_res,
-     data.is_finished);
+     data.is_finished, data.output_dims, data.full_dims);
 }
 
+/**
+ * @brief: road region of interest of the camera frame (cap mode),
+ *         left/up even, right/down odd (inclusive) as VPC requires
+ */
+const uint32_t kCapRoiLeft = 0;
+const uint32_t kCapRoiUp = 176;
+const uint32_t kCapRoiRight = 1247;
+const uint32_t kCapRoiDown = 553;
+
 struct BoundingBox {
   uint32_t lt_x;
   uint32_t lt_y;
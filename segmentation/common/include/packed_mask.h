@@ -0,0 +1,541 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef COMMON_PACKED_MASK_H_
+#define COMMON_PACKED_MASK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PACKED_MASK_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PACKED_MASK_SSE2 1
+#endif
+
+/**
+ * @brief: binary masks kept over time. PackedMask holds 1 bit per pixel,
+ *         rows padded to 128 bits with zero bits, so area, IoU and the set
+ *         operations run on whole 128-bit words (NEON, SSE2) with a scalar
+ *         fallback giving identical results. RunLengthMask holds the set
+ *         runs of every row for storage and row-wise iteration
+ */
+namespace packedmask {
+
+// bits of a word, words of a SIMD step
+const uint32_t kWordBits = 64;
+const uint32_t kStepWords = 2;
+
+#if defined(PACKED_MASK_NEON)
+/**
+ * @brief: set bits of each 64-bit lane
+ */
+inline uint64x2_t WordCounts(uint64x2_t words) {
+  uint8x16_t bits = vcntq_u8(vreinterpretq_u8_u64(words));
+  return vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+}
+
+inline uint64_t LaneSum(uint64x2_t sum) {
+  return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+}
+#elif defined(PACKED_MASK_SSE2)
+/**
+ * @brief: set bits of each 64-bit lane, bits per byte then sum of bytes
+ */
+inline __m128i WordCounts(__m128i x) {
+  const __m128i m1 = _mm_set1_epi8(0x55);
+  const __m128i m2 = _mm_set1_epi8(0x33);
+  const __m128i m4 = _mm_set1_epi8(0x0F);
+  x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+  x = _mm_add_epi8(_mm_and_si128(x, m2),
+                   _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+  x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+  return _mm_sad_epu8(x, _mm_setzero_si128());
+}
+
+inline uint64_t LaneSum(__m128i sum) {
+  return static_cast<uint64_t>(_mm_cvtsi128_si32(sum))
+      + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+#endif
+
+/**
+ * @brief: set bits of words
+ */
+inline uint64_t PopCount(const uint64_t *words, uint32_t count) {
+  uint64_t total = 0;
+  uint32_t i = 0;
+#if defined(PACKED_MASK_NEON)
+  uint64x2_t sum = vdupq_n_u64(0);
+  for (; i + kStepWords <= count; i += kStepWords) {
+    sum = vaddq_u64(sum, WordCounts(vld1q_u64(words + i)));
+  }
+  total = LaneSum(sum);
+#elif defined(PACKED_MASK_SSE2)
+  __m128i sum = _mm_setzero_si128();
+  for (; i + kStepWords <= count; i += kStepWords) {
+    sum = _mm_add_epi64(sum, WordCounts(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(words + i))));
+  }
+  total = LaneSum(sum);
+#endif
+  for (; i < count; i++) {
+    total += __builtin_popcountll(words[i]);
+  }
+  return total;
+}
+
+/**
+ * @brief: 1 bit per pixel mask
+ */
+class PackedMask {
+public:
+  PackedMask() : width_(0), height_(0), stride_(0) {
+  }
+
+  /**
+   * @brief: size mask and clear it, storage is kept when large enough
+   */
+  void Reset(uint32_t width, uint32_t height) {
+    width_ = width;
+    height_ = height;
+    stride_ = (width + kWordBits * kStepWords - 1) / (kWordBits * kStepWords)
+        * kStepWords;
+    words_.assign(stride_ * height, 0);
+  }
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  /**
+   * @brief: words per row, a whole number of SIMD steps
+   */
+  uint32_t Stride() const {
+    return stride_;
+  }
+
+  uint64_t *Row(uint32_t y) {
+    return &words_[y * stride_];
+  }
+
+  const uint64_t *Row(uint32_t y) const {
+    return &words_[y * stride_];
+  }
+
+  bool Get(uint32_t x, uint32_t y) const {
+    return ((Row(y)[x / kWordBits] >> (x % kWordBits)) & 1) != 0;
+  }
+
+  void Set(uint32_t x, uint32_t y, bool value) {
+    uint64_t bit = 1ull << (x % kWordBits);
+    uint64_t &word = Row(y)[x / kWordBits];
+    word = value ? (word | bit) : (word & ~bit);
+  }
+
+  /**
+   * @brief: same size
+   */
+  bool SameShape(const PackedMask &other) const {
+    return width_ == other.width_ && height_ == other.height_;
+  }
+
+  /**
+   * @brief: set pixels, the area
+   */
+  uint64_t Count() const {
+    return PopCount(words_.data(), words_.size());
+  }
+
+  /**
+   * @brief: row y from probability, value >= threshold is set
+   * @param [in]: prob: probability of first pixel
+   * @param [in]: stride: floats between pixels, 2 for channel 0 of HWC
+   *              with 2 channels, 1 for a plane
+   */
+  void FromProbability(uint32_t y, const float *prob, uint32_t stride,
+                       float threshold);
+
+  /**
+   * @brief: row y from 8-bit levels, value >= level is set
+   */
+  void FromLevels(uint32_t y, const uint8_t *levels, uint8_t level);
+
+  /**
+   * @brief: this = this & other, same shape
+   */
+  void And(const PackedMask &other) {
+    Combine(other, kAnd);
+  }
+
+  /**
+   * @brief: this = this | other, same shape
+   */
+  void Or(const PackedMask &other) {
+    Combine(other, kOr);
+  }
+
+  /**
+   * @brief: this = this ^ other, same shape
+   */
+  void Xor(const PackedMask &other) {
+    Combine(other, kXor);
+  }
+
+  /**
+   * @brief: area of intersection and union in one pass, same shape
+   */
+  void CountOverlap(const PackedMask &other, uint64_t &intersection,
+                    uint64_t &united) const;
+
+  /**
+   * @brief: intersection over union, 1 for two empty masks
+   */
+  double IoU(const PackedMask &other) const {
+    uint64_t intersection = 0;
+    uint64_t united = 0;
+    CountOverlap(other, intersection, united);
+    return united == 0 ? 1.0 : static_cast<double>(intersection) / united;
+  }
+
+  /**
+   * @brief: call run(begin, end) for every set run [begin, end) of row y
+   */
+  template<typename Func>
+  void ForEachRun(uint32_t y, Func run) const {
+    const uint64_t *words = Row(y);
+    uint32_t x = NextBit(words, 0, true);
+    while (x < width_) {
+      uint32_t end = NextBit(words, x, false);
+      run(x, end);
+      x = NextBit(words, end, true);
+    }
+  }
+
+private:
+  enum Operation {
+    kAnd = 0,
+    kOr = 1,
+    kXor = 2
+  };
+
+  void Combine(const PackedMask &other, Operation operation);
+
+  /**
+   * @brief: first x from start with the bit equal to value, width if none
+   */
+  uint32_t NextBit(const uint64_t *words, uint32_t start, bool value) const {
+    uint32_t index = start / kWordBits;
+    uint32_t words_in_row = (width_ + kWordBits - 1) / kWordBits;
+    if (index >= words_in_row) {
+      return width_;
+    }
+    uint64_t word = value ? words[index] : ~words[index];
+    word &= ~0ull << (start % kWordBits);
+    while (word == 0) {
+      if (++index >= words_in_row) {
+        return width_;
+      }
+      word = value ? words[index] : ~words[index];
+    }
+    uint32_t x = index * kWordBits + __builtin_ctzll(word);
+    // padding bits are clear, a clear search ends at width
+    return x < width_ ? x : width_;
+  }
+
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t stride_;
+  std::vector<uint64_t> words_;
+};
+
+inline void PackedMask::FromProbability(uint32_t y, const float *prob,
+                                        uint32_t stride, float threshold) {
+  uint64_t *words = Row(y);
+  for (uint32_t i = 0; i < stride_; i++) {
+    words[i] = 0;
+  }
+  uint32_t x = 0;
+  // 16 pixels per step give 16 bits, never across a word
+#if defined(PACKED_MASK_NEON)
+  const uint32_t weights[4] = { 1, 2, 4, 8 };
+  uint32x4_t weight = vld1q_u32(weights);
+  float32x4_t limit = vdupq_n_f32(threshold);
+  for (; stride <= 2 && x + 16 <= width_; x += 16) {
+    uint32_t bits = 0;
+    for (uint32_t k = 0; k < 4; k++) {
+      const float *p = prob + (x + k * 4) * stride;
+      float32x4_t value = (stride == 1) ? vld1q_f32(p) : vld2q_f32(p).val[0];
+      uint32x4_t set = vandq_u32(vcgeq_f32(value, limit), weight);
+      uint32x2_t half = vpadd_u32(vget_low_u32(set), vget_high_u32(set));
+      bits |= vget_lane_u32(vpadd_u32(half, half), 0) << (k * 4);
+    }
+    words[x / kWordBits] |= static_cast<uint64_t>(bits) << (x % kWordBits);
+  }
+#elif defined(PACKED_MASK_SSE2)
+  __m128 limit = _mm_set1_ps(threshold);
+  for (; stride <= 2 && x + 16 <= width_; x += 16) {
+    uint32_t bits = 0;
+    for (uint32_t k = 0; k < 4; k++) {
+      const float *p = prob + (x + k * 4) * stride;
+      __m128 value = _mm_loadu_ps(p);
+      if (stride == 2) {
+        // channel 0 of 4 pixels
+        value = _mm_shuffle_ps(value, _mm_loadu_ps(p + 4),
+                               _MM_SHUFFLE(2, 0, 2, 0));
+      }
+      bits |= _mm_movemask_ps(_mm_cmpge_ps(value, limit)) << (k * 4);
+    }
+    words[x / kWordBits] |= static_cast<uint64_t>(bits) << (x % kWordBits);
+  }
+#endif
+  for (; x < width_; x++) {
+    if (prob[x * stride] >= threshold) {
+      words[x / kWordBits] |= 1ull << (x % kWordBits);
+    }
+  }
+}
+
+inline void PackedMask::FromLevels(uint32_t y, const uint8_t *levels,
+                                   uint8_t level) {
+  uint64_t *words = Row(y);
+  for (uint32_t i = 0; i < stride_; i++) {
+    words[i] = 0;
+  }
+  uint32_t x = 0;
+#if defined(PACKED_MASK_NEON)
+  const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                1, 2, 4, 8, 16, 32, 64, 128 };
+  uint8x16_t weight = vld1q_u8(weights);
+  uint8x16_t limit = vdupq_n_u8(level);
+  for (; x + 16 <= width_; x += 16) {
+    uint8x16_t set = vandq_u8(vcgeq_u8(vld1q_u8(levels + x), limit), weight);
+    // byte 0 sums the low 8 pixels, byte 1 the high 8
+    uint8x8_t sum = vpadd_u8(vget_low_u8(set), vget_high_u8(set));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    uint64_t bits = vget_lane_u16(vreinterpret_u16_u8(sum), 0);
+    words[x / kWordBits] |= bits << (x % kWordBits);
+  }
+#elif defined(PACKED_MASK_SSE2)
+  __m128i limit = _mm_set1_epi8(static_cast<char>(level));
+  for (; x + 16 <= width_; x += 16) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+        levels + x));
+    // unsigned value >= level where max(value, level) is value
+    __m128i set = _mm_cmpeq_epi8(_mm_max_epu8(value, limit), value);
+    uint64_t bits = static_cast<uint32_t>(_mm_movemask_epi8(set));
+    words[x / kWordBits] |= bits << (x % kWordBits);
+  }
+#endif
+  for (; x < width_; x++) {
+    if (levels[x] >= level) {
+      words[x / kWordBits] |= 1ull << (x % kWordBits);
+    }
+  }
+}
+
+inline void PackedMask::Combine(const PackedMask &other,
+                                Operation operation) {
+  uint64_t *dst = words_.data();
+  const uint64_t *src = other.words_.data();
+  uint32_t count = words_.size();
+  uint32_t i = 0;
+#if defined(PACKED_MASK_NEON)
+  for (; i + kStepWords <= count; i += kStepWords) {
+    uint64x2_t a = vld1q_u64(dst + i);
+    uint64x2_t b = vld1q_u64(src + i);
+    a = (operation == kAnd) ? vandq_u64(a, b)
+        : ((operation == kOr) ? vorrq_u64(a, b) : veorq_u64(a, b));
+    vst1q_u64(dst + i, a);
+  }
+#elif defined(PACKED_MASK_SSE2)
+  for (; i + kStepWords <= count; i += kStepWords) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    a = (operation == kAnd) ? _mm_and_si128(a, b)
+        : ((operation == kOr) ? _mm_or_si128(a, b) : _mm_xor_si128(a, b));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), a);
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = (operation == kAnd) ? (dst[i] & src[i])
+        : ((operation == kOr) ? (dst[i] | src[i]) : (dst[i] ^ src[i]));
+  }
+}
+
+inline void PackedMask::CountOverlap(const PackedMask &other,
+                                     uint64_t &intersection,
+                                     uint64_t &united) const {
+  const uint64_t *a = words_.data();
+  const uint64_t *b = other.words_.data();
+  uint32_t count = words_.size();
+  uint32_t i = 0;
+  intersection = 0;
+  united = 0;
+#if defined(PACKED_MASK_NEON)
+  uint64x2_t both = vdupq_n_u64(0);
+  uint64x2_t either = vdupq_n_u64(0);
+  for (; i + kStepWords <= count; i += kStepWords) {
+    uint64x2_t x = vld1q_u64(a + i);
+    uint64x2_t y = vld1q_u64(b + i);
+    both = vaddq_u64(both, WordCounts(vandq_u64(x, y)));
+    either = vaddq_u64(either, WordCounts(vorrq_u64(x, y)));
+  }
+  intersection = LaneSum(both);
+  united = LaneSum(either);
+#elif defined(PACKED_MASK_SSE2)
+  __m128i both = _mm_setzero_si128();
+  __m128i either = _mm_setzero_si128();
+  for (; i + kStepWords <= count; i += kStepWords) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    both = _mm_add_epi64(both, WordCounts(_mm_and_si128(x, y)));
+    either = _mm_add_epi64(either, WordCounts(_mm_or_si128(x, y)));
+  }
+  intersection = LaneSum(both);
+  united = LaneSum(either);
+#endif
+  for (; i < count; i++) {
+    intersection += __builtin_popcountll(a[i] & b[i]);
+    united += __builtin_popcountll(a[i] | b[i]);
+  }
+}
+
+/**
+ * @brief: set runs of every row, begin and end of a run as 16 bits
+ */
+class RunLengthMask {
+public:
+  RunLengthMask() : width_(0), height_(0) {
+  }
+
+  /**
+   * @brief: runs of mask, storage is kept when large enough
+   */
+  void Encode(const PackedMask &mask) {
+    width_ = mask.Width();
+    height_ = mask.Height();
+    runs_.clear();
+    rows_.resize(height_ + 1);
+    for (uint32_t y = 0; y < height_; y++) {
+      rows_[y] = runs_.size();
+      mask.ForEachRun(y, [this](uint32_t begin, uint32_t end) {
+        runs_.push_back(static_cast<uint16_t>(begin));
+        runs_.push_back(static_cast<uint16_t>(end));
+      });
+    }
+    rows_[height_] = runs_.size();
+  }
+
+  /**
+   * @brief: packed mask of the runs
+   */
+  void Decode(PackedMask &mask) const {
+    mask.Reset(width_, height_);
+    for (uint32_t y = 0; y < height_; y++) {
+      uint64_t *words = mask.Row(y);
+      ForEachRun(y, [words](uint32_t begin, uint32_t end) {
+        for (uint32_t x = begin; x < end;) {
+          // bits of the run in this word
+          uint32_t shift = x % kWordBits;
+          uint32_t bits = end - x < kWordBits - shift ? end - x
+              : kWordBits - shift;
+          uint64_t ones = (bits == kWordBits) ? ~0ull : ((1ull << bits) - 1);
+          words[x / kWordBits] |= ones << shift;
+          x += bits;
+        }
+      });
+    }
+  }
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  /**
+   * @brief: set pixels, the area
+   */
+  uint64_t Count() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i + 1 < runs_.size(); i += 2) {
+      total += runs_[i + 1] - runs_[i];
+    }
+    return total;
+  }
+
+  /**
+   * @brief: runs of all rows
+   */
+  uint32_t Runs() const {
+    return runs_.size() / 2;
+  }
+
+  /**
+   * @brief: bytes of the runs and row index
+   */
+  size_t Bytes() const {
+    return runs_.size() * sizeof(uint16_t) + rows_.size() * sizeof(uint32_t);
+  }
+
+  /**
+   * @brief: call run(begin, end) for every set run [begin, end) of row y
+   */
+  template<typename Func>
+  void ForEachRun(uint32_t y, Func run) const {
+    for (uint32_t i = rows_[y]; i < rows_[y + 1]; i += 2) {
+      run(runs_[i], runs_[i + 1]);
+    }
+  }
+
+private:
+  uint32_t width_;
+  uint32_t height_;
+  std::vector<uint16_t> runs_;
+  std::vector<uint32_t> rows_;
+};
+
+}  // namespace packedmask
+
+#endif /* COMMON_PACKED_MASK_H_ */
@@ -8,6 +8,7 @@
 #ifndef COMMON_TOOL_API_H_
 #define COMMON_TOOL_API_H_
 
+#include <chrono>
 #include <memory>
 #include "hiaiengine/data_type.h"
 #include "hiaiengine/data_type_reg.h"
@@ -32,4 +33,10 @@ std::shared_ptr<Type> MakeSharedNoThrow() {
 #define MAKE_SHARED_NO_THROW(memory, memory_type) \
     memory = MakeSharedNoThrow<memory_type>();
 
+// steady clock time in microseconds, comparable between host engines
+inline int64_t SteadyNowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #endif /* COMMON_TOOL_API_H_ */
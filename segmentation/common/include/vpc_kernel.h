@@ -0,0 +1,367 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef COMMON_VPC_KERNEL_H_
+#define COMMON_VPC_KERNEL_H_
+
+#include <stdint.h>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VPC_KERNEL_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VPC_KERNEL_SSE2 1
+#endif
+
+/**
+ * @brief: host implementation of the crop and resize done by ez_dvpp
+ *         DvppBasicVpcProc: crop + bilinear resize, NV12 or BGR input,
+ *         NV12 (YUV420SP, UV order) output without padding.
+ *         parameter rules follow VPC: crop left/up even, crop right/down
+ *         odd (inclusive), destination width/height even.
+ *         horizontal pass is table driven, vertical pass is SIMD
+ *         (NEON/SSE2) with a scalar fallback giving identical results
+ */
+namespace vpc {
+
+enum InputFormat {
+  kInputNv12 = 0,
+  kInputBgr = 1
+};
+
+/**
+ * @brief: source image
+ */
+struct SrcImage {
+  const uint8_t *data;
+  InputFormat format;
+  uint32_t width;
+  uint32_t height;
+  // bytes per row: Y plane stride for NV12, width * 3 for BGR
+  uint32_t stride;
+  // rows of Y plane before UV plane (NV12), >= height
+  uint32_t height_stride;
+};
+
+/**
+ * @brief: crop region, right/down inclusive like DvppBasicVpcPara
+ */
+struct CropRegion {
+  uint32_t left;
+  uint32_t up;
+  uint32_t right;
+  uint32_t down;
+};
+
+// fixed point bits of bilinear weights
+const int32_t kWeightBits = 7;
+const int32_t kWeightOne = 1 << kWeightBits;
+// vertical pass output shift, both passes scale by kWeightOne
+const int32_t kVerticalShift = 2 * kWeightBits;
+// VPC resize ratio limits
+const uint32_t kMaxUpscale = 16;
+const uint32_t kMaxDownscale = 32;
+
+inline uint32_t AlignUp(uint32_t value, uint32_t align) {
+  return (value + align - 1) / align * align;
+}
+
+/**
+ * @brief: NV12 output size
+ */
+inline uint32_t OutputSize(uint32_t width, uint32_t height) {
+  return width * height * 3 / 2;
+}
+
+/**
+ * @brief: check parameters against VPC rules
+ * @return: true: valid; false: invalid
+ */
+inline bool CheckParams(const SrcImage &src, const CropRegion &crop,
+                        uint32_t dst_width, uint32_t dst_height) {
+  if (src.data == nullptr || dst_width == 0 || dst_height == 0) {
+    return false;
+  }
+  // crop left-top even, right-bottom odd, destination even
+  if ((crop.left & 1) != 0 || (crop.up & 1) != 0 || (crop.right & 1) != 1
+      || (crop.down & 1) != 1 || (dst_width & 1) != 0
+      || (dst_height & 1) != 0) {
+    return false;
+  }
+  if (crop.right >= src.width || crop.down >= src.height
+      || crop.left >= crop.right || crop.up >= crop.down) {
+    return false;
+  }
+  uint32_t crop_width = crop.right - crop.left + 1;
+  uint32_t crop_height = crop.down - crop.up + 1;
+  return dst_width <= crop_width * kMaxUpscale
+      && dst_height <= crop_height * kMaxUpscale
+      && dst_width * kMaxDownscale >= crop_width
+      && dst_height * kMaxDownscale >= crop_height;
+}
+
+/**
+ * @brief: source offset and weight of every destination coordinate,
+ *         pixel centers aligned (half pixel offset)
+ * @param [in]: src_size: source size (pixels)
+ * @param [in]: dst_size: destination size (pixels)
+ * @param [out]: offsets: first source pixel
+ * @param [out]: weights: weight of second source pixel, 0..kWeightOne
+ */
+inline void BuildTable(uint32_t src_size, uint32_t dst_size,
+                       std::vector<int32_t> &offsets,
+                       std::vector<int32_t> &weights) {
+  offsets.resize(dst_size);
+  weights.resize(dst_size);
+  // 16.16 fixed point source coordinate
+  int64_t scale = ((int64_t) src_size << 16) / dst_size;
+  int64_t pos = scale / 2 - (1 << 15);
+  for (uint32_t i = 0; i < dst_size; i++, pos += scale) {
+    int64_t clamped = pos < 0 ? 0 : pos;
+    int32_t offset = (int32_t) (clamped >> 16);
+    int32_t weight = (int32_t) (((clamped & 0xFFFF) * kWeightOne + (1 << 15))
+        >> 16);
+    if (offset >= (int32_t) src_size - 1) {
+      offset = src_size - 1;
+      weight = 0;
+    }
+    if (weight == kWeightOne) {
+      offset++;
+      weight = 0;
+    }
+    offsets[i] = offset;
+    weights[i] = weight;
+  }
+}
+
+/**
+ * @brief: horizontal pass of one row, output scaled by kWeightOne
+ * @param [in]: src: first source pixel of crop region in this row
+ * @param [in]: channels: interleaved channels
+ * @param [in]: src_width: crop width (pixels)
+ */
+inline void HorizontalRow(const uint8_t *src, uint32_t channels,
+                          uint32_t src_width, const int32_t *offsets,
+                          const int32_t *weights, uint32_t dst_width,
+                          int16_t *dst) {
+  int32_t last = src_width - 1;
+  for (uint32_t x = 0; x < dst_width; x++) {
+    int32_t weight = weights[x];
+    const uint8_t *p0 = src + offsets[x] * channels;
+    const uint8_t *p1 = (offsets[x] < last) ? p0 + channels : p0;
+    for (uint32_t c = 0; c < channels; c++) {
+      dst[x * channels + c] = (int16_t) (p0[c] * (kWeightOne - weight)
+          + p1[c] * weight);
+    }
+  }
+}
+
+/**
+ * @brief: vertical pass, dst = (r0 * (1 - w) + r1 * w) rounded
+ * @param [in]: count: values in the row
+ */
+inline void VerticalRow(const int16_t *row0, const int16_t *row1,
+                        int32_t weight, uint32_t count, uint8_t *dst) {
+  int32_t weight0 = kWeightOne - weight;
+  uint32_t i = 0;
+#if defined(VPC_KERNEL_NEON)
+  uint16x4_t w0 = vdup_n_u16((uint16_t) weight0);
+  uint16x4_t w1 = vdup_n_u16((uint16_t) weight);
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t r0 = vreinterpretq_u16_s16(vld1q_s16(row0 + i));
+    uint16x8_t r1 = vreinterpretq_u16_s16(vld1q_s16(row1 + i));
+    uint32x4_t lo = vmull_u16(vget_low_u16(r0), w0);
+    lo = vmlal_u16(lo, vget_low_u16(r1), w1);
+    uint32x4_t hi = vmull_u16(vget_high_u16(r0), w0);
+    hi = vmlal_u16(hi, vget_high_u16(r1), w1);
+    uint16x8_t sum = vcombine_u16(vrshrn_n_u32(lo, kVerticalShift),
+                                  vrshrn_n_u32(hi, kVerticalShift));
+    vst1_u8(dst + i, vqmovn_u16(sum));
+  }
+#elif defined(VPC_KERNEL_SSE2)
+  __m128i weights = _mm_set1_epi32((weight << 16) | (weight0 & 0xFFFF));
+  __m128i round = _mm_set1_epi32(1 << (kVerticalShift - 1));
+  for (; i + 8 <= count; i += 8) {
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + i));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + i));
+    // interleave (r0, r1) pairs, madd with (w0, w1)
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), weights);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kVerticalShift);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kVerticalShift);
+    __m128i packed = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_packus_epi16(packed, packed));
+  }
+#endif
+  for (; i < count; i++) {
+    int32_t value = (row0[i] * weight0 + row1[i] * weight
+        + (1 << (kVerticalShift - 1))) >> kVerticalShift;
+    dst[i] = (uint8_t) (value > 255 ? 255 : value);
+  }
+}
+
+/**
+ * @brief: bilinear resize of an interleaved 8-bit plane
+ * @param [in]: src: first pixel of the crop region
+ * @param [in]: src_stride: bytes per source row
+ * @param [in]: channels: interleaved channels
+ * @param [in]: src_width, src_height: crop size (pixels)
+ * @param [out]: dst: destination plane, rows packed
+ */
+inline void ResizePlane(const uint8_t *src, uint32_t src_stride,
+                        uint32_t channels, uint32_t src_width,
+                        uint32_t src_height, uint8_t *dst,
+                        uint32_t dst_width, uint32_t dst_height) {
+  std::vector<int32_t> x_offsets;
+  std::vector<int32_t> x_weights;
+  std::vector<int32_t> y_offsets;
+  std::vector<int32_t> y_weights;
+  BuildTable(src_width, dst_width, x_offsets, x_weights);
+  BuildTable(src_height, dst_height, y_offsets, y_weights);
+
+  // two horizontally resized rows, reused while source row pair is same
+  uint32_t count = dst_width * channels;
+  std::vector<int16_t> rows(count * 2);
+  int16_t *row0 = &rows[0];
+  int16_t *row1 = &rows[count];
+  int32_t row0_index = -1;
+  int32_t row1_index = -1;
+  int32_t last = src_height - 1;
+  for (uint32_t y = 0; y < dst_height; y++) {
+    int32_t y0 = y_offsets[y];
+    int32_t y1 = (y0 < last) ? y0 + 1 : y0;
+    if (y0 == row1_index) {
+      // slide window down by one source row
+      int16_t *tmp = row0;
+      row0 = row1;
+      row1 = tmp;
+      row0_index = row1_index;
+      row1_index = -1;
+    }
+    if (y0 != row0_index) {
+      HorizontalRow(src + y0 * src_stride, channels, src_width, &x_offsets[0],
+                    &x_weights[0], dst_width, row0);
+      row0_index = y0;
+    }
+    if (y1 != row1_index) {
+      HorizontalRow(src + y1 * src_stride, channels, src_width, &x_offsets[0],
+                    &x_weights[0], dst_width, row1);
+      row1_index = y1;
+    }
+    VerticalRow(row0, row1, y_weights[y], count, dst + y * count);
+  }
+}
+
+/**
+ * @brief: BGR (packed) to NV12, BT.601 limited range, chroma of every
+ *         2x2 block averaged
+ */
+inline void BgrToNv12(const uint8_t *bgr, uint32_t width, uint32_t height,
+                      uint8_t *nv12) {
+  uint8_t *y_plane = nv12;
+  uint8_t *uv_plane = nv12 + width * height;
+  for (uint32_t y = 0; y < height; y += 2) {
+    const uint8_t *line0 = bgr + y * width * 3;
+    const uint8_t *line1 = line0 + width * 3;
+    uint8_t *y_line0 = y_plane + y * width;
+    uint8_t *y_line1 = y_line0 + width;
+    uint8_t *uv_line = uv_plane + (y / 2) * width;
+    for (uint32_t x = 0; x < width; x += 2) {
+      int32_t sum_b = 0;
+      int32_t sum_g = 0;
+      int32_t sum_r = 0;
+      const uint8_t *pixels[4] = { line0 + x * 3, line0 + x * 3 + 3,
+          line1 + x * 3, line1 + x * 3 + 3 };
+      uint8_t *lumas[4] = { y_line0 + x, y_line0 + x + 1, y_line1 + x,
+          y_line1 + x + 1 };
+      for (int32_t k = 0; k < 4; k++) {
+        int32_t b = pixels[k][0];
+        int32_t g = pixels[k][1];
+        int32_t r = pixels[k][2];
+        *lumas[k] = (uint8_t) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        sum_b += b;
+        sum_g += g;
+        sum_r += r;
+      }
+      int32_t b = (sum_b + 2) >> 2;
+      int32_t g = (sum_g + 2) >> 2;
+      int32_t r = (sum_r + 2) >> 2;
+      uv_line[x] = (uint8_t) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      uv_line[x + 1] = (uint8_t) (((112 * r - 94 * g - 18 * b + 128) >> 8)
+          + 128);
+    }
+  }
+}
+
+/**
+ * @brief: crop and resize to NV12, same operation as DvppBasicVpcProc
+ * @param [in]: src: source image
+ * @param [in]: crop: crop region
+ * @param [in]: dst_width: destination width (even)
+ * @param [in]: dst_height: destination height (even)
+ * @param [out]: dst: NV12 buffer of OutputSize(dst_width, dst_height)
+ * @return: true: success; false: parameters break VPC rules
+ */
+inline bool CropResize(const SrcImage &src, const CropRegion &crop,
+                       uint32_t dst_width, uint32_t dst_height,
+                       uint8_t *dst) {
+  if (dst == nullptr || !CheckParams(src, crop, dst_width, dst_height)) {
+    return false;
+  }
+  uint32_t crop_width = crop.right - crop.left + 1;
+  uint32_t crop_height = crop.down - crop.up + 1;
+
+  if (src.format == kInputBgr) {
+    std::vector<uint8_t> bgr(dst_width * dst_height * 3);
+    ResizePlane(src.data + crop.up * src.stride + crop.left * 3, src.stride,
+                3, crop_width, crop_height, &bgr[0], dst_width, dst_height);
+    BgrToNv12(&bgr[0], dst_width, dst_height, dst);
+    return true;
+  }
+
+  // Y plane, then interleaved UV plane at half resolution
+  ResizePlane(src.data + crop.up * src.stride + crop.left, src.stride, 1,
+              crop_width, crop_height, dst, dst_width, dst_height);
+  const uint8_t *src_uv = src.data + src.height_stride * src.stride;
+  ResizePlane(src_uv + (crop.up / 2) * src.stride + crop.left, src.stride, 2,
+              crop_width / 2, crop_height / 2, dst + dst_width * dst_height,
+              dst_width / 2, dst_height / 2);
+  return true;
+}
+
+}  // namespace vpc
+
+#endif /* COMMON_VPC_KERNEL_H_ */
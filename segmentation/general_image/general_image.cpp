@@ -52,6 +52,7 @@
 #include "hiaiengine/log.h"
 #include "opencv2/opencv.hpp"
 #include "tool_api.h"
+#include "vpc_kernel.h"
 
 extern "C" {
 #include "driver/peripheral_api.h"
@@ -74,6 +75,9 @@ const string kImagePathSeparator = ",";
 // path separator
 const string kPathSeparator = "/";
 
+// print transfer statistics every N frames
+const uint64_t kTransferReportInterval = 100;
+
 }
 
 // register custom data type
@@ -82,6 +86,9 @@ HIAI_REGISTER_DATA_TYPE("EngineTrans", EngineTrans);
 GeneralImage::GeneralImage() {
   config_ = nullptr;
   frame_id_ = 0;
+  sent_frames_ = 0;
+  sent_bytes_ = 0;
+  preprocess_ms_ = 0.0;
   exit_flag_ = CAMERADATASETS_INIT;
   params_.insert(pair<string, string>("Channel-1", IntToString(CAMERAL_1)));
   params_.insert(pair<string, string>("Channel-2", IntToString(CAMERAL_2)));
@@ -97,6 +104,9 @@ HIAI_StatusT GeneralImage::Init(
   HIAI_ENGINE_LOG("[CameraDatasets] start init!");
   if (config_ == nullptr) {
     config_ = make_shared<CameraDatasetsConfig>();
+    config_->host_preprocess = 0;
+    config_->model_width = 623;
+    config_->model_height = 188;
   }
 
   for (int index = 0; index < ai_config.items_size(); ++index) {
@@ -117,6 +127,10 @@ HIAI_StatusT GeneralImage::Init(
       config_->image_num = atoi(value.data());
     } else if (name == "mode") {
       config_->mode = atoi(value.data());
+    } else if (name == "host_preprocess") {
+      config_->host_preprocess = atoi(value.data());
+    } else if (name == "model_size") {
+      ParseImageSize(value, config_->model_width, config_->model_height);
     } else {
       HIAI_ENGINE_LOG("unused config name: %s", name.c_str());
     }
@@ -125,7 +139,8 @@ HIAI_StatusT GeneralImage::Init(
   HIAI_StatusT ret = HIAI_OK;
   bool failed_flag = (config_->image_format == PARSEPARAM_FAIL
       || config_->channel_id == PARSEPARAM_FAIL
-      || config_->resolution_width == 0 || config_->resolution_height == 0);
+      || config_->resolution_width == 0 || config_->resolution_height == 0
+      || config_->model_width == 0 || config_->model_height == 0);
   if (failed_flag) {
     string msg = config_->ToString();
     msg.append(" config data failed");
@@ -256,7 +271,8 @@ string GeneralImage::CameraDatasetsConfig::ToString() const {
   log_info_stream << "fps:" << this->fps << ", camera:" << this->channel_id
       << ", image_format:" << this->image_format << ", resolution_width:"
       << this->resolution_width << ", resolution_height:"
-      << this->resolution_height;
+      << this->resolution_height << ", model_size:" << this->model_width
+      << "x" << this->model_height;
 
   return log_info_stream.str();
 }
@@ -344,6 +360,41 @@ GeneralImage::CameraOperationCode GeneralImage::PreCapProcess() {
   return kCameraOk;
 }
 
+bool GeneralImage::HostPreProcess(shared_ptr<EngineTrans> &image_handle) {
+  ImageInfo &image_info = image_handle->image_info;
+  // destination resolution need even number, same as device pre-process
+  uint32_t dst_width = (image_handle->console_params.model_width >> 1) << 1;
+  uint32_t dst_height = (image_handle->console_params.model_height >> 1) << 1;
+  uint32_t dst_size = vpc::OutputSize(dst_width, dst_height);
+  shared_ptr<uint8_t> dst_data(new (nothrow) uint8_t[dst_size],
+                               default_delete<uint8_t[]>());
+  if (dst_data == nullptr) {
+    HIAI_ENGINE_LOG("[CameraDatasets] new resize buffer failed");
+    return false;
+  }
+
+  vpc::SrcImage src;
+  src.data = image_info.data.get();
+  src.format = vpc::kInputNv12;
+  src.width = image_info.width;
+  src.height = image_info.height;
+  src.stride = image_info.width;
+  src.height_stride = image_info.height;
+  vpc::CropRegion crop = { kCapRoiLeft, kCapRoiUp, kCapRoiRight,
+      kCapRoiDown };
+  if (!vpc::CropResize(src, crop, dst_width, dst_height, dst_data.get())) {
+    HIAI_ENGINE_LOG("[CameraDatasets] host crop and resize failed");
+    return false;
+  }
+
+  image_info.data = dst_data;
+  image_info.size = dst_size;
+  image_info.width = dst_width;
+  image_info.height = dst_height;
+  image_info.preprocessed = true;
+  return true;
+}
+
 bool GeneralImage::DoCapProcess() {
   CameraOperationCode ret_code = PreCapProcess();
   cout << "--image-- prepare camera ok" << endl;
@@ -379,8 +430,8 @@ bool GeneralImage::DoCapProcess() {
     char infopath[12];
     sprintf(infopath, "%d.png", read_num);
     image_handle->image_info.path = infopath;
-    image_handle->console_params.model_height = 188;
-    image_handle->console_params.model_width = 623;
+    image_handle->console_params.model_height = config_->model_height;
+    image_handle->console_params.model_width = config_->model_width;
     image_handle->console_params.output_path = "./";
     
     read_size = (int) image_handle->image_info.size;
@@ -401,8 +452,26 @@ bool GeneralImage::DoCapProcess() {
       continue;
     }
     else {
+      image_handle->image_info.timestamp_us = SteadyNowUs();
+      if (config_->host_preprocess != 0) {
+        int64_t begin_us = SteadyNowUs();
+        if (!HostPreProcess(image_handle)) {
+          cout << "--image-- host preprocess failed" << endl;
+          break;
+        }
+        preprocess_ms_ += (SteadyNowUs() - begin_us) / 1000.0;
+      }
       // cout << "--image-- send to inference engine" << endl;
       SendToEngine(image_handle);
+      sent_frames_++;
+      sent_bytes_ += image_handle->image_info.size;
+      if (sent_frames_ % kTransferReportInterval == 0) {
+        INFO_LOG("--image-- frames:%lu, bytes/frame:%lu, "
+                 "host preprocess ms/frame:%.3f",
+                 (unsigned long) sent_frames_,
+                 (unsigned long) (sent_bytes_ / sent_frames_),
+                 preprocess_ms_ / sent_frames_);
+      }
       if (read_num >= config_->image_num+5) break;
     }
   }
@@ -433,8 +502,8 @@ bool GeneralImage::DoPictureProcess() {
     }
     // send data to inference engine
     image_handle->console_params.input_path = "test.png";
-    image_handle->console_params.model_height = 188;
-    image_handle->console_params.model_width = 623;
+    image_handle->console_params.model_height = config_->model_height;
+    image_handle->console_params.model_width = config_->model_width;
     image_handle->console_params.output_path = "./";
     image_handle->image_info.mode = config_->mode;
     if (read_num < 5) {
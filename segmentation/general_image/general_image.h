@@ -72,6 +72,11 @@ public:
     int resolution_height;
     int image_num;
     int mode;
+    // crop and resize to model size before sending to device
+    int host_preprocess;
+    // model input size sent with each frame, device rungs may override
+    int model_width;
+    int model_height;
     std::string ToString() const;
   };
 
@@ -157,6 +162,14 @@ private:
    */
   bool DoPictureProcess();
 
+  /**
+   * @brief  crop road region and resize to model size on host, so that
+   *         only model sized NV12 image is sent to device
+   * @param [in]  image_handle   camera frame, replaced by resized image
+   * @return  success-->true ; fail-->false
+   */
+  bool HostPreProcess(std::shared_ptr<EngineTrans> &image_handle);
+
   /**
    * @brief   preprocess for cap camera
    * @return  camera code
@@ -200,6 +213,10 @@ private:
     // ret of cameradataset
     int exit_flag_;
     uint32_t frame_id_;
+    // transfer statistics of camera frames sent to device
+    uint64_t sent_frames_;
+    uint64_t sent_bytes_;
+    double preprocess_ms_;
 
 };
 
@@ -0,0 +1,123 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "cascade_gate.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+CascadeGate::CascadeGate(float threshold, float confidence,
+                         const Region &region, bool planar)
+    : threshold_(threshold),
+      confidence_(confidence),
+      region_(region),
+      planar_(planar),
+      frames_(0),
+      full_runs_(0),
+      fast_ms_total_(0.0),
+      full_ms_total_(0.0) {
+}
+
+bool CascadeGate::ParseRegion(const string &value, Region &region) {
+  Region parsed;
+  if (sscanf(value.c_str(), "%f,%f,%f,%f", &parsed.left, &parsed.top,
+             &parsed.right, &parsed.bottom) != 4) {
+    return false;
+  }
+  if (parsed.left < 0.0f || parsed.top < 0.0f || parsed.right > 1.0f
+      || parsed.bottom > 1.0f || parsed.left >= parsed.right
+      || parsed.top >= parsed.bottom) {
+    return false;
+  }
+  region = parsed;
+  return true;
+}
+
+float CascadeGate::LowConfidenceFraction(const float *data, uint32_t width,
+                                         uint32_t height,
+                                         uint32_t channels) const {
+  uint32_t col_begin = static_cast<uint32_t>(region_.left * width);
+  uint32_t col_end = min(width, static_cast<uint32_t>(region_.right * width));
+  uint32_t row_begin = static_cast<uint32_t>(region_.top * height);
+  uint32_t row_end = min(height,
+                         static_cast<uint32_t>(region_.bottom * height));
+  if (data == nullptr || channels == 0 || col_begin >= col_end
+      || row_begin >= row_end) {
+    return 0.0f;
+  }
+
+  // floats between pixels and between channels of a pixel
+  uint32_t pixel_stride = planar_ ? 1 : channels;
+  uint32_t channel_stride = planar_ ? width * height : 1;
+  uint32_t low_count = 0;
+  for (uint32_t i = row_begin; i < row_end; i++) {
+    const float *pixel = data + (i * width + col_begin) * pixel_stride;
+    for (uint32_t j = col_begin; j < col_end; j++, pixel += pixel_stride) {
+      float top = pixel[0];
+      for (uint32_t c = 1; c < channels; c++) {
+        top = max(top, pixel[c * channel_stride]);
+      }
+      low_count += (top < confidence_) ? 1 : 0;
+    }
+  }
+  return static_cast<float>(low_count)
+      / ((row_end - row_begin) * (col_end - col_begin));
+}
+
+void CascadeGate::Record(double fast_ms, double full_ms, bool full_run) {
+  frames_++;
+  fast_ms_total_ += fast_ms;
+  if (full_run) {
+    full_runs_++;
+    full_ms_total_ += full_ms;
+  }
+}
+
+string CascadeGate::ToString() const {
+  stringstream log_info_stream("");
+  if (frames_ == 0) {
+    return "cascade frames:0";
+  }
+  double full_rate = (double) full_runs_ / frames_;
+  double fast_ms = fast_ms_total_ / frames_;
+  double full_ms = (full_runs_ == 0) ? 0.0 : full_ms_total_ / full_runs_;
+  double average_ms = (fast_ms_total_ + full_ms_total_) / frames_;
+  log_info_stream << "cascade frames:" << frames_ << ", fast_only_rate:"
+      << (1.0 - full_rate) * 100.0 << "%, full_rate:" << full_rate * 100.0
+      << "%, fast_ms:" << fast_ms << ", full_ms:" << full_ms
+      << ", average_ms:" << average_ms << ", threshold:" << threshold_;
+  return log_info_stream.str();
+}
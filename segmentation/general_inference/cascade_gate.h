@@ -0,0 +1,127 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_INFERENCE_CASCADE_GATE_H_
+#define GENERAL_INFERENCE_CASCADE_GATE_H_
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief: decides whether the full model must run after the fast model,
+ *         based on the fraction of low-confidence pixels in a region of the
+ *         fast mask, and keeps per-stage statistics
+ */
+class CascadeGate {
+public:
+  /**
+   * @brief: region of the mask, as fractions of mask width and height
+   */
+  struct Region {
+    float left;
+    float top;
+    float right;
+    float bottom;
+  };
+
+  /**
+   * @brief: constructor
+   * @param [in]: threshold: max fraction of low-confidence pixels accepted
+   * @param [in]: confidence: pixel is low-confidence when its top class
+   *              probability is below this value
+   * @param [in]: region: region of the mask that is checked
+   * @param [in]: planar: mask layout is CHW, else HWC
+   */
+  CascadeGate(float threshold, float confidence, const Region &region,
+              bool planar);
+
+  /**
+   * @brief: parse region, format: left,top,right,bottom
+   * @param [in]: value: config value
+   * @param [out]: region: parsed region
+   * @return: true: success; false: failed
+   */
+  static bool ParseRegion(const std::string &value, Region &region);
+
+  /**
+   * @brief: fraction of low-confidence pixels of the region
+   * @param [in]: data: mask, layout HWC or CHW as constructed
+   * @param [in]: width: mask width
+   * @param [in]: height: mask height
+   * @param [in]: channels: class channels
+   * @return: fraction in [0, 1]
+   */
+  float LowConfidenceFraction(const float *data, uint32_t width,
+                              uint32_t height, uint32_t channels) const;
+
+  /**
+   * @brief: full model is needed or not for this fast mask
+   */
+  bool NeedFullModel(const float *data, uint32_t width, uint32_t height,
+                     uint32_t channels) const {
+    return LowConfidenceFraction(data, width, height, channels) > threshold_;
+  }
+
+  /**
+   * @brief: record one frame
+   * @param [in]: fast_ms: service time of fast stage
+   * @param [in]: full_ms: service time of full stage, ignored if not run
+   * @param [in]: full_run: full model has run or not
+   */
+  void Record(double fast_ms, double full_ms, bool full_run);
+
+  /**
+   * @brief: frames recorded
+   */
+  uint64_t Frames() const {
+    return frames_;
+  }
+
+  /**
+   * @brief: statistics string: per-stage rates and average latency
+   */
+  std::string ToString() const;
+
+private:
+  float threshold_;
+  float confidence_;
+  Region region_;
+  bool planar_;
+
+  uint64_t frames_;
+  uint64_t full_runs_;
+  double fast_ms_total_;
+  double full_ms_total_;
+};
+
+#endif /* GENERAL_INFERENCE_CASCADE_GATE_H_ */
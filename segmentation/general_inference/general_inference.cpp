@@ -33,6 +33,7 @@
 
 #include "general_inference.h"
 
+#include <chrono>
 #include <vector>
 #include <sstream>
 
@@ -40,6 +41,7 @@
 #include "ascenddk/ascend_ezdvpp/dvpp_process.h"
 #include "opencv2/opencv.hpp"
 #include "tool_api.h"
+#include "vpc_kernel.h"
 
 using hiai::Engine;
 using hiai::ImageData;
@@ -50,6 +52,85 @@ namespace {
 // model_path parameter key in graph.config
 const string kModelPathParamKey = "model_path";
 
+// cache_size parameter key in graph.config
+const string kCacheSizeParamKey = "cache_size";
+
+// model_ladder parameter key in graph.config
+const string kModelLadderParamKey = "model_ladder";
+
+// latency_budget parameter key in graph.config (unit: milliseconds)
+const string kLatencyBudgetParamKey = "latency_budget";
+
+// ladder_hysteresis parameter key in graph.config
+const string kLadderHysteresisParamKey = "ladder_hysteresis";
+
+// ladder_dwell parameter key in graph.config (unit: frames)
+const string kLadderDwellParamKey = "ladder_dwell";
+
+// default ladder hysteresis, fraction of budget kept free before step up
+const double kDefaultLadderHysteresis = 0.2;
+
+// default frames measured before the ladder switches again
+const uint32_t kDefaultLadderDwell = 10;
+
+// cascade_model parameter key in graph.config, format: path:WxH
+const string kCascadeModelParamKey = "cascade_model";
+
+// cascade_threshold parameter key in graph.config
+const string kCascadeThresholdParamKey = "cascade_threshold";
+
+// cascade_confidence parameter key in graph.config
+const string kCascadeConfidenceParamKey = "cascade_confidence";
+
+// cascade_region parameter key in graph.config
+const string kCascadeRegionParamKey = "cascade_region";
+
+// default max fraction of low-confidence pixels kept by the fast model
+const float kDefaultCascadeThreshold = 0.1f;
+
+// default top class probability below which a pixel is low-confidence
+const float kDefaultCascadeConfidence = 0.8f;
+
+// print cascade statistics every N frames
+const uint64_t kCascadeReportInterval = 100;
+
+// keyframe_interval parameter key in graph.config, 1 disables propagation
+const string kKeyframeIntervalParamKey = "keyframe_interval";
+
+// keyframe_min_interval parameter key in graph.config
+const string kKeyframeMinIntervalParamKey = "keyframe_min_interval";
+
+// keyframe_drift parameter key in graph.config (unit: frame pixels)
+const string kKeyframeDriftParamKey = "keyframe_drift";
+
+// default max motion between keyframes (unit: frame pixels)
+const float kDefaultKeyframeDrift = 16.0f;
+
+// print keyframe statistics every N frames
+const uint64_t kKeyframeReportInterval = 100;
+
+// output_layout parameter key in graph.config: nhwc or nchw
+const string kOutputLayoutParamKey = "output_layout";
+
+// preprocess parameter key in graph.config: dvpp, cpu or auto
+const string kPreprocessParamKey = "preprocess";
+
+// VPC input alignment
+const uint32_t kVpcWidthAlign = 128;
+const uint32_t kVpcHeightAlign = 16;
+
+// print preprocess statistics every N frames
+const uint64_t kPreprocessReportInterval = 100;
+
+// model name prefix in AI model description
+const string kModelNamePrefix = "model_";
+
+// print cache statistics every N lookups
+const uint64_t kCacheReportInterval = 100;
+
+// print ladder statistics every N inferences
+const uint64_t kLadderReportInterval = 100;
+
 // output port (engine port begin with 0)
 const uint32_t kSendDataPort = 0;
 
@@ -67,6 +148,34 @@ const __useconds_t kSleepInterval = 200000;
 
 // length of image info array
 const uint32_t kImageInfoLength = 3;
+
+// most channels of a segmentation output
+const uint32_t kMaxOutputChannels = 64;
+
+/**
+ * @brief: reported output shape is used only when it accounts for the
+ *         whole output tensor and looks like a mask; flattened outputs
+ *         such as {117124, 2} report shapes that do not
+ */
+bool PlausibleOutput(const hiai::TensorDimension &dims) {
+  uint64_t bytes = (uint64_t) dims.c * dims.h * dims.w * sizeof(float);
+  return dims.c >= 1 && dims.c <= kMaxOutputChannels && dims.h >= 2
+      && dims.w >= 2 && dims.h <= UINT16_MAX && dims.w <= UINT16_MAX
+      && dims.size > 0 && bytes == dims.size;
+}
+
+/**
+ * @brief: mask size of a result: output size when the model reported
+ *         it, else the model input size
+ */
+void MaskSize(const EngineTrans &trans, uint32_t &width, uint32_t &height) {
+  width = trans.output_dims.width;
+  height = trans.output_dims.height;
+  if (width == 0 || height == 0) {
+    width = trans.console_params.model_width;
+    height = trans.console_params.model_height;
+  }
+}
 }
 
 // register custom data type
@@ -74,51 +183,340 @@ HIAI_REGISTER_DATA_TYPE("Output", Output);
 HIAI_REGISTER_DATA_TYPE("EngineTrans", EngineTrans);
 
 GeneralInference::GeneralInference() {
-  ai_model_manager_ = nullptr;
+  inference_cache_ = nullptr;
+  resolution_controller_ = nullptr;
+  cascade_gate_ = nullptr;
+  cascade_model_id_ = 0;
+  mask_propagator_ = nullptr;
+  preprocess_mode_ = kPreprocessDvpp;
+  frame_count_ = 0;
 }
 
-HIAI_StatusT GeneralInference::Init(
-    const hiai::AIConfig& config,
-    const vector<hiai::AIModelDescription>& model_desc) {
-  HIAI_ENGINE_LOG("Start initialize!");
+bool GeneralInference::ParseModelLadder(const string &value) {
+  models_.clear();
+  stringstream ladder_stream(value);
+  string rung_value;
+  while (getline(ladder_stream, rung_value, ',')) {
+    // path:WxH
+    string::size_type colon = rung_value.rfind(':');
+    string::size_type cross = rung_value.rfind('x');
+    if (colon == string::npos || cross == string::npos || cross < colon) {
+      ERROR_LOG("Invalid model ladder item: %s", rung_value.c_str());
+      return false;
+    }
+    ModelRung rung;
+    rung.path = rung_value.substr(0, colon);
+    rung.width = atoi(rung_value.substr(colon + 1, cross - colon - 1).data());
+    rung.height = atoi(rung_value.substr(cross + 1).data());
+    if (rung.path.empty() || rung.width == 0 || rung.height == 0) {
+      ERROR_LOG("Invalid model ladder item: %s", rung_value.c_str());
+      return false;
+    }
+    models_.push_back(rung);
+  }
+  return !models_.empty();
+}
 
-  // initialize aiModelManager
-  if (ai_model_manager_ == nullptr) {
-    MAKE_SHARED_NO_THROW(ai_model_manager_, hiai::AIModelManager);
-    if (ai_model_manager_ == nullptr) {
+bool GeneralInference::LoadModels(const hiai::AIConfig& config) {
+  for (uint32_t i = 0; i < models_.size(); i++) {
+    ModelRung &rung = models_[i];
+    MAKE_SHARED_NO_THROW(rung.ai_model_manager, hiai::AIModelManager);
+    if (rung.ai_model_manager == nullptr) {
       ERROR_LOG("Failed to initialize AIModelManager.");
-      return HIAI_ERROR;
+      return false;
+    }
+
+    hiai::AIModelDescription fd_model_desc;
+    fd_model_desc.set_name(kModelNamePrefix + to_string(i));
+    fd_model_desc.set_path(rung.path);
+    vector<hiai::AIModelDescription> model_desc_vec;
+    model_desc_vec.push_back(fd_model_desc);
+    hiai::AIStatus ret = rung.ai_model_manager->Init(config, model_desc_vec);
+    // initialize AI model manager failed
+    if (ret != hiai::SUCCESS) {
+      HIAI_ENGINE_LOG(HIAI_GRAPH_INVALID_VALUE, "initialize AI model failed");
+      ERROR_LOG("Failed to initialize AI model %s.", rung.path.c_str());
+      return false;
+    }
+    // shapes are read once here, frames carry them to post
+    vector<hiai::TensorDimension> input_dims;
+    vector<hiai::TensorDimension> output_dims;
+    ret = rung.ai_model_manager->GetModelIOTensorDim(
+        fd_model_desc.name(), input_dims, output_dims);
+    if (ret != hiai::SUCCESS || output_dims.empty()) {
+      INFO_LOG("--inference-- model %u reports no output shape", i);
+    } else if (!PlausibleOutput(output_dims[0])) {
+      // left 0, post uses the model size
+      INFO_LOG("--inference-- model %u output shape %ux%ux%u of %u bytes "
+               "rejected", i, output_dims[0].c, output_dims[0].h,
+               output_dims[0].w, output_dims[0].size);
+    } else {
+      rung.output.channels = output_dims[0].c;
+      rung.output.height = output_dims[0].h;
+      rung.output.width = output_dims[0].w;
     }
+    if (ret == hiai::SUCCESS && !input_dims.empty() && rung.width == 0
+        && input_dims[0].w > 0 && input_dims[0].h > 0) {
+      rung.width = input_dims[0].w;
+      rung.height = input_dims[0].h;
+    }
+    INFO_LOG("--inference-- load model %u: %s %ux%u, output %ux%ux%u", i,
+             rung.path.c_str(), rung.width, rung.height, rung.output.channels,
+             rung.output.height, rung.output.width);
   }
+  return true;
+}
+
+HIAI_StatusT GeneralInference::Init(
+    const hiai::AIConfig& config,
+    const vector<hiai::AIModelDescription>& model_desc) {
+  HIAI_ENGINE_LOG("Start initialize!");
 
   // get parameters from graph.config
-  // set model path to AI model description
-  hiai::AIModelDescription fd_model_desc;
+  string model_path = "";
+  string model_ladder = "";
+  uint32_t cache_size = 0;
+  double latency_budget = 0.0;
+  double ladder_hysteresis = kDefaultLadderHysteresis;
+  uint32_t ladder_dwell = kDefaultLadderDwell;
+  string cascade_model = "";
+  float cascade_threshold = kDefaultCascadeThreshold;
+  float cascade_confidence = kDefaultCascadeConfidence;
+  CascadeGate::Region cascade_region = { 0.0f, 0.0f, 1.0f, 1.0f };
+  uint32_t keyframe_interval = 1;
+  uint32_t keyframe_min_interval = 1;
+  float keyframe_drift = kDefaultKeyframeDrift;
+  bool planar_output = false;
   for (int index = 0; index < config.items_size(); index++) {
     const ::hiai::AIConfigItem& item = config.items(index);
     // get model path
     if (item.name() == kModelPathParamKey) {
-      const char* model_path = item.value().data();
-      fd_model_desc.set_path(model_path);
+      model_path = item.value();
+    } else if (item.name() == kModelLadderParamKey) {
+      model_ladder = item.value();
+    } else if (item.name() == kCacheSizeParamKey) {
+      cache_size = atoi(item.value().data());
+    } else if (item.name() == kLatencyBudgetParamKey) {
+      latency_budget = atof(item.value().data());
+    } else if (item.name() == kLadderHysteresisParamKey) {
+      ladder_hysteresis = atof(item.value().data());
+    } else if (item.name() == kLadderDwellParamKey) {
+      ladder_dwell = atoi(item.value().data());
+    } else if (item.name() == kCascadeModelParamKey) {
+      cascade_model = item.value();
+    } else if (item.name() == kCascadeThresholdParamKey) {
+      cascade_threshold = atof(item.value().data());
+    } else if (item.name() == kCascadeConfidenceParamKey) {
+      cascade_confidence = atof(item.value().data());
+    } else if (item.name() == kPreprocessParamKey) {
+      if (item.value() == "cpu") {
+        preprocess_mode_ = kPreprocessCpu;
+      } else if (item.value() == "auto") {
+        preprocess_mode_ = kPreprocessAuto;
+      } else {
+        preprocess_mode_ = kPreprocessDvpp;
+      }
+    } else if (item.name() == kKeyframeIntervalParamKey) {
+      keyframe_interval = atoi(item.value().data());
+    } else if (item.name() == kKeyframeMinIntervalParamKey) {
+      keyframe_min_interval = atoi(item.value().data());
+    } else if (item.name() == kKeyframeDriftParamKey) {
+      keyframe_drift = atof(item.value().data());
+    } else if (item.name() == kOutputLayoutParamKey) {
+      planar_output = (item.value() == "nchw");
+    } else if (item.name() == kCascadeRegionParamKey) {
+      if (!item.value().empty()
+          && !CascadeGate::ParseRegion(item.value(), cascade_region)) {
+        ERROR_LOG("Invalid cascade region: %s", item.value().c_str());
+        return HIAI_ERROR;
+      }
     }
     // else: noting need to do
   }
 
-  // initialize model manager
-  vector<hiai::AIModelDescription> model_desc_vec;
-  model_desc_vec.push_back(fd_model_desc);
-  hiai::AIStatus ret = ai_model_manager_->Init(config, model_desc_vec);
-  // initialize AI model manager failed
-  if (ret != hiai::SUCCESS) {
-    HIAI_ENGINE_LOG(HIAI_GRAPH_INVALID_VALUE, "initialize AI model failed");
-    ERROR_LOG("Failed to initialize AI model.");
+  // model ladder overrides the single model path
+  if (!model_ladder.empty()) {
+    if (!ParseModelLadder(model_ladder)) {
+      ERROR_LOG("Failed to parse model ladder.");
+      return HIAI_ERROR;
+    }
+  } else {
+    ModelRung rung;
+    rung.path = model_path;
+    rung.width = 0;
+    rung.height = 0;
+    models_.push_back(rung);
+  }
+  // ladder levels, cascade fast model is loaded behind them
+  uint32_t ladder_size = models_.size();
+  if (!cascade_model.empty()) {
+    vector<ModelRung> ladder;
+    ladder.swap(models_);
+    if (!ParseModelLadder(cascade_model) || models_.size() != 1) {
+      ERROR_LOG("Failed to parse cascade model.");
+      return HIAI_ERROR;
+    }
+    cascade_model_id_ = ladder.size();
+    ladder.push_back(models_[0]);
+    models_.swap(ladder);
+    cascade_gate_.reset(new (nothrow) CascadeGate(
+        cascade_threshold, cascade_confidence, cascade_region,
+        planar_output));
+    if (cascade_gate_ == nullptr) {
+      ERROR_LOG("Failed to initialize CascadeGate.");
+      return HIAI_ERROR;
+    }
+  }
+  if (!LoadModels(config)) {
     return HIAI_ERROR;
   }
+  // sizes of the ladder as the models report them
+  vector<uint32_t> level_pixels;
+  for (uint32_t i = 0; i < ladder_size; i++) {
+    level_pixels.push_back(models_[i].width * models_[i].height);
+  }
+
+  // initialize keyframe mask propagation
+  mask_propagator_.reset(new (nothrow) MaskPropagator(
+      keyframe_interval, keyframe_min_interval, keyframe_drift,
+      planar_output));
+  if (mask_propagator_ == nullptr) {
+    ERROR_LOG("Failed to initialize MaskPropagator.");
+    return HIAI_ERROR;
+  }
+
+  // initialize resolution controller
+  resolution_controller_.reset(new (nothrow) ResolutionController(
+      level_pixels, latency_budget, ladder_hysteresis, ladder_dwell));
+  if (resolution_controller_ == nullptr) {
+    ERROR_LOG("Failed to initialize ResolutionController.");
+    return HIAI_ERROR;
+  }
+
+  // initialize inference result cache
+  if (inference_cache_ == nullptr) {
+    inference_cache_.reset(new (nothrow) InferenceCache(cache_size));
+    if (inference_cache_ == nullptr) {
+      ERROR_LOG("Failed to initialize InferenceCache.");
+      return HIAI_ERROR;
+    }
+  }
 
   HIAI_ENGINE_LOG("End initialize!");
   return HIAI_OK;
 }
 
+bool GeneralInference::DvppCropResize(
+    const DvppBasicVpcPara &resize_para,
+    const shared_ptr<EngineTrans> &image_handle,
+    ImageData<u_int8_t> &resized_image) {
+  DvppProcess dvpp_resize_img(resize_para);
+  DvppVpcOutput dvpp_output;
+  int ret = dvpp_resize_img.DvppBasicVpcProc(
+      image_handle->image_info.data.get(), image_handle->image_info.size,
+      &dvpp_output);
+  if (ret != kDvppOperationOk) {
+    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
+                    "call ez_dvpp failed, failed to resize image.");
+    return false;
+  }
+
+  // call success, set data and size
+  resized_image.data.reset(dvpp_output.buffer, default_delete<u_int8_t[]>());
+  resized_image.size = dvpp_output.size;
+  resized_image.width = resize_para.dest_resolution.width;
+  resized_image.height = resize_para.dest_resolution.height;
+  return true;
+}
+
+bool GeneralInference::CpuCropResize(
+    const DvppBasicVpcPara &resize_para,
+    const shared_ptr<EngineTrans> &image_handle,
+    ImageData<u_int8_t> &resized_image) {
+  vpc::SrcImage src;
+  src.data = image_handle->image_info.data.get();
+  src.width = resize_para.src_resolution.width;
+  src.height = resize_para.src_resolution.height;
+  if (resize_para.input_image_type == INPUT_BGR) {
+    src.format = vpc::kInputBgr;
+    src.stride = src.width * 3;
+    src.height_stride = src.height;
+  } else {
+    src.format = vpc::kInputNv12;
+    src.stride = resize_para.is_input_align ?
+        vpc::AlignUp(src.width, kVpcWidthAlign) : src.width;
+    src.height_stride = resize_para.is_input_align ?
+        vpc::AlignUp(src.height, kVpcHeightAlign) : src.height;
+  }
+  vpc::CropRegion crop = { resize_para.crop_left, resize_para.crop_up,
+      resize_para.crop_right, resize_para.crop_down };
+  uint32_t dst_width = resize_para.dest_resolution.width;
+  uint32_t dst_height = resize_para.dest_resolution.height;
+
+  // input must hold the whole source image
+  uint32_t src_size = (src.format == vpc::kInputBgr) ?
+      src.stride * src.height : src.stride * src.height_stride * 3 / 2;
+  if ((uint32_t) image_handle->image_info.size < src_size) {
+    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
+                    "cpu resize failed, input size %d less than %u.",
+                    image_handle->image_info.size, src_size);
+    return false;
+  }
+
+  uint32_t dst_size = vpc::OutputSize(dst_width, dst_height);
+  u_int8_t *dst_buffer = new (nothrow) u_int8_t[dst_size];
+  if (dst_buffer == nullptr) {
+    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
+                    "cpu resize failed, new buffer failed.");
+    return false;
+  }
+  resized_image.data.reset(dst_buffer, default_delete<u_int8_t[]>());
+  if (!vpc::CropResize(src, crop, dst_width, dst_height, dst_buffer)) {
+    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
+                    "cpu resize failed, invalid crop or resize parameter.");
+    resized_image.data.reset();
+    return false;
+  }
+  resized_image.size = dst_size;
+  resized_image.width = dst_width;
+  resized_image.height = dst_height;
+  return true;
+}
+
+bool GeneralInference::CropResize(const DvppBasicVpcPara &resize_para,
+                                  const shared_ptr<EngineTrans> &image_handle,
+                                  ImageData<u_int8_t> &resized_image) {
+  chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+  bool on_cpu = (preprocess_mode_ == kPreprocessCpu);
+  bool ret = false;
+  if (!on_cpu) {
+    ret = DvppCropResize(resize_para, image_handle, resized_image);
+    // VPC busy or failed, spill to CPU
+    if (!ret && preprocess_mode_ == kPreprocessAuto) {
+      on_cpu = true;
+    }
+  }
+  if (on_cpu) {
+    ret = CpuCropResize(resize_para, image_handle, resized_image);
+  }
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now()
+      - begin;
+
+  PreprocessStat &stat = on_cpu ? cpu_stat_ : dvpp_stat_;
+  stat.frames++;
+  stat.total_ms += elapsed.count();
+  if ((dvpp_stat_.frames + cpu_stat_.frames) % kPreprocessReportInterval
+      == 0) {
+    INFO_LOG("--inference-- preprocess dvpp frames:%lu avg_ms:%.3f, "
+             "cpu frames:%lu avg_ms:%.3f",
+             (unsigned long) dvpp_stat_.frames,
+             dvpp_stat_.frames ? dvpp_stat_.total_ms / dvpp_stat_.frames : 0.0,
+             (unsigned long) cpu_stat_.frames,
+             cpu_stat_.frames ? cpu_stat_.total_ms / cpu_stat_.frames : 0.0);
+  }
+  return ret;
+}
+
 bool GeneralInference::PreProcessCap(const shared_ptr<EngineTrans> &image_handle,
                                   ImageData<u_int8_t> &resized_image) {
   // call ez_dvpp to resize image
@@ -134,13 +532,11 @@ bool GeneralInference::PreProcessCap(const shared_ptr<EngineTrans> &image_handle
   resize_para.src_resolution.height = height;
 
   // set crop left-top point (need even number)
-  resize_para.crop_left = 0;
-  resize_para.crop_up = 176;
+  resize_para.crop_left = kCapRoiLeft;
+  resize_para.crop_up = kCapRoiUp;
   // set crop right-bottom point (need odd number)
-  uint32_t crop_right = 1247;
-  uint32_t crop_down = 553;
-  resize_para.crop_right = crop_right;
-  resize_para.crop_down = crop_down;
+  resize_para.crop_right = kCapRoiRight;
+  resize_para.crop_down = kCapRoiDown;
 
   // set destination resolution ratio (need even number)
   uint32_t dst_width = ((image_handle->console_params.model_width) >> 1) << 1;
@@ -151,24 +547,25 @@ bool GeneralInference::PreProcessCap(const shared_ptr<EngineTrans> &image_handle
   // set input image align or not
   resize_para.is_input_align = true;
 
-  // call
-  DvppProcess dvpp_resize_img(resize_para);
-  DvppVpcOutput dvpp_output;
-  int ret = dvpp_resize_img.DvppBasicVpcProc(
-      image_handle->image_info.data.get(), image_handle->image_info.size,
-      &dvpp_output);
-  if (ret != kDvppOperationOk) {
-    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
-                    "call ez_dvpp failed, failed to resize image.");
-    return false;
+  // image engine has cropped and resized on host
+  if (image_handle->image_info.preprocessed) {
+    if ((uint32_t) width == dst_width && (uint32_t) height == dst_height) {
+      resized_image.data = image_handle->image_info.data;
+      resized_image.size = image_handle->image_info.size;
+      resized_image.width = dst_width;
+      resized_image.height = dst_height;
+      return true;
+    }
+    // other model size of the ladder, resize the whole region again
+    resize_para.crop_left = 0;
+    resize_para.crop_up = 0;
+    resize_para.crop_right = ((width >> 1) << 1) - 1;
+    resize_para.crop_down = ((height >> 1) << 1) - 1;
+    resize_para.is_input_align = false;
   }
 
-  // call success, set data and size
-  resized_image.data.reset(dvpp_output.buffer, default_delete<u_int8_t[]>());
-  resized_image.size = dvpp_output.size;
-  resized_image.width = dst_width;
-  resized_image.height = dst_height;
-  return true;
+  // call
+  return CropResize(resize_para, image_handle, resized_image);
 }
 
 bool GeneralInference::PreProcessPicture(const shared_ptr<EngineTrans> &image_handle,
@@ -205,29 +602,11 @@ bool GeneralInference::PreProcessPicture(const shared_ptr<EngineTrans> &image_ha
   resize_para.is_input_align = false;
 
   // call
-  DvppProcess dvpp_resize_img(resize_para);
-  DvppVpcOutput dvpp_output;
-  int ret = dvpp_resize_img.DvppBasicVpcProc(
-      image_handle->image_info.data.get(), image_handle->image_info.size,
-      &dvpp_output);
-  if (ret != kDvppOperationOk) {
-    HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
-                    "call ez_dvpp failed, failed to resize image.");
-    return false;
-  }
-
-  // call success, set data and size
-  resized_image.data.reset(dvpp_output.buffer, default_delete<u_int8_t[]>());
-  resized_image.size = dvpp_output.size;
-  resized_image.width = dst_width;
-  resized_image.height = dst_height;
-  image_handle->image_info.width = dst_width;
-  image_handle->image_info.height = dst_height;
-  return true;
+  return CropResize(resize_para, image_handle, resized_image);
 }
 
 bool GeneralInference::Inference(
-    const ImageData<u_int8_t> &resized_image,
+    uint32_t model_id, const ImageData<u_int8_t> &resized_image,
     vector<shared_ptr<hiai::IAITensor>> &output_data_vec) {
   // neural buffer
   shared_ptr<hiai::AINeuralNetworkBuffer> neural_buf = nullptr;
@@ -247,9 +626,11 @@ bool GeneralInference::Inference(
 
   // Call Process
   // 1. create output tensor
+  shared_ptr<hiai::AIModelManager> ai_model_manager =
+      models_[model_id].ai_model_manager;
   hiai::AIContext ai_context;
-  hiai::AIStatus ret = ai_model_manager_->CreateOutputTensor(input_data_vec,
-                                                             output_data_vec);
+  hiai::AIStatus ret = ai_model_manager->CreateOutputTensor(input_data_vec,
+                                                            output_data_vec);
   // create failed
   if (ret != hiai::SUCCESS) {
     HIAI_ENGINE_LOG(HIAI_ENGINE_RUN_ARGS_NOT_RIGHT,
@@ -259,8 +640,8 @@ bool GeneralInference::Inference(
 
   // 2. process
   HIAI_ENGINE_LOG("aiModelManager->Process start");
-  ret = ai_model_manager_->Process(ai_context, input_data_vec, output_data_vec,
-                                   kAiModelProcessTimeout);
+  ret = ai_model_manager->Process(ai_context, input_data_vec, output_data_vec,
+                                  kAiModelProcessTimeout);
   // process failed, also need to send data to post process
   if (ret != hiai::SUCCESS) {
     cout << "--inference-- aiModelManager->Process failed!" << endl;
@@ -303,10 +684,10 @@ void GeneralInference::SendError(const std::string &err_msg,
   }
 }
 
-bool GeneralInference::SendResult(
-    shared_ptr<EngineTrans> &image_handle,
-    vector<shared_ptr<hiai::IAITensor>> &output_data_vec) {
-
+bool GeneralInference::ArrangeResult(
+    const vector<shared_ptr<hiai::IAITensor>> &output_data_vec,
+    vector<Output> &outputs) {
+  outputs.clear();
   for (uint32_t i = 0; i < output_data_vec.size(); i++) {
     shared_ptr<hiai::AISimpleTensor> result_tensor = static_pointer_cast<
         hiai::AISimpleTensor>(output_data_vec[i]);
@@ -328,12 +709,146 @@ bool GeneralInference::SendResult(
                       "dealing results: memcpy_s() error=%d", mem_ret);
       continue;
     }
-    image_handle->inference_res.emplace_back(out);
+    outputs.emplace_back(out);
   }
+  return outputs.size() == output_data_vec.size();
+}
 
+bool GeneralInference::SendResult(shared_ptr<EngineTrans> &image_handle,
+                                  const vector<Output> &outputs) {
+  image_handle->inference_res = outputs;
+  image_handle->full_dims = models_[0].output;
   return SendToEngine(image_handle);
 }
 
+bool GeneralInference::RunModel(uint32_t model_id,
+                                shared_ptr<EngineTrans> &image_handle,
+                                uint32_t base_width, uint32_t base_height,
+                                vector<Output> &outputs, double &service_ms,
+                                bool &cache_hit, string &reason) {
+  chrono::steady_clock::time_point service_begin = chrono::steady_clock::now();
+
+  // lower resolution models also resize smaller
+  const ModelRung &rung = models_[model_id];
+  bool own_size = (rung.width > 0 && rung.height > 0);
+  image_handle->console_params.model_width = own_size ? rung.width : base_width;
+  image_handle->console_params.model_height =
+      own_size ? rung.height : base_height;
+  image_handle->output_dims = rung.output;
+
+  // resize image
+  // cout << "--inference-- resize image" << endl;
+  ImageData<u_int8_t> resized_image;
+  bool preprocess_ok = (image_handle->image_info.mode == 0) ?
+      PreProcessCap(image_handle, resized_image) :
+      PreProcessPicture(image_handle, resized_image);
+  if (!preprocess_ok) {
+    reason = "resize image failed.";
+    return false;
+  }
+
+  // same model input seen before, reuse its result and skip Process
+  uint64_t input_hash = 0;
+  cache_hit = false;
+  if (inference_cache_->Enabled()) {
+    input_hash = InferenceCache::Hash(resized_image.data.get(),
+                                      resized_image.size);
+    cache_hit = inference_cache_->Lookup(input_hash, model_id,
+                                         resized_image.size, outputs);
+    if (inference_cache_->Lookups() % kCacheReportInterval == 0) {
+      INFO_LOG("--inference-- %s", inference_cache_->ToString().c_str());
+    }
+  }
+
+  if (!cache_hit) {
+    // inference
+    // cout << "--inference-- inference" << endl;
+    vector<shared_ptr<hiai::IAITensor>> output_data;
+    if (!Inference(model_id, resized_image, output_data)) {
+      reason = "inference failed.";
+      return false;
+    }
+    if (!ArrangeResult(output_data, outputs)) {
+      reason = "arrange inference result failed.";
+      return false;
+    }
+    inference_cache_->Insert(input_hash, model_id, resized_image.size,
+                             outputs);
+  }
+  if (outputs.empty()) {
+    reason = "inference result is empty.";
+    return false;
+  }
+
+  chrono::duration<double, milli> service_time = chrono::steady_clock::now()
+      - service_begin;
+  service_ms = service_time.count();
+  return true;
+}
+
+HIAI_StatusT GeneralInference::InferKeyframe(
+    shared_ptr<EngineTrans> &image_handle, uint32_t base_width,
+    uint32_t base_height, vector<Output> &outputs) {
+  string reason = "";
+  double fast_ms = 0.0;
+  bool full_run = true;
+  if (cascade_gate_ != nullptr) {
+    // fast stage, full model only runs for hard frames
+    bool cache_hit = false;
+    if (!RunModel(cascade_model_id_, image_handle, base_width, base_height,
+                  outputs, fast_ms, cache_hit, reason)) {
+      string err_msg = "Failed to deal file=" + image_handle->image_info.path
+          + ". Reason: " + reason;
+      SendError(err_msg, image_handle);
+      return HIAI_ERROR;
+    }
+    uint32_t mask_width = 0;
+    uint32_t mask_height = 0;
+    MaskSize(*image_handle, mask_width, mask_height);
+    uint32_t mask_pixels = mask_width * mask_height;
+    if (mask_pixels > 0) {
+      uint32_t channels = outputs[0].size / (mask_pixels * sizeof(float));
+      full_run = cascade_gate_->NeedFullModel(
+          reinterpret_cast<const float *>(outputs[0].data.get()),
+          mask_width, mask_height, channels);
+    }
+  }
+
+  if (full_run) {
+    // pick model of the ladder, lower resolution models also resize smaller
+    uint32_t model_id = resolution_controller_->Level();
+    double service_ms = 0.0;
+    bool cache_hit = false;
+    if (!RunModel(model_id, image_handle, base_width, base_height, outputs,
+                  service_ms, cache_hit, reason)) {
+      string err_msg = "Failed to deal file=" + image_handle->image_info.path
+          + ". Reason: " + reason;
+      SendError(err_msg, image_handle);
+      return HIAI_ERROR;
+    }
+
+    // only real model runs drive the resolution ladder
+    if (!cache_hit) {
+      resolution_controller_->Update(service_ms);
+      if (++frame_count_ % kLadderReportInterval == 0) {
+        INFO_LOG("--inference-- %s",
+                 resolution_controller_->ToString().c_str());
+      }
+    }
+    if (cascade_gate_ != nullptr) {
+      cascade_gate_->Record(fast_ms, service_ms, true);
+    }
+  } else {
+    cascade_gate_->Record(fast_ms, 0.0, false);
+  }
+  if (cascade_gate_ != nullptr
+      && cascade_gate_->Frames() % kCascadeReportInterval == 0) {
+    INFO_LOG("--inference-- %s", cascade_gate_->ToString().c_str());
+  }
+
+  return HIAI_OK;
+}
+
 HIAI_IMPL_ENGINE_PROCESS("general_inference",
     GeneralInference, INPUT_SIZE) {
   HIAI_StatusT ret = HIAI_OK;
@@ -356,40 +871,59 @@ HIAI_IMPL_ENGINE_PROCESS("general_inference",
     return HIAI_ERROR;
   }
 
-  // resize image
-  // cout << "--inference-- resize image" << endl;
-  ImageData<u_int8_t> resized_image;
-  if (image_handle->image_info.mode==0) {
-    if (!PreProcessCap(image_handle, resized_image)) {
-      string err_msg = "Failed to deal file=" + image_handle->image_info.path
-          + ". Reason: resize image failed.";
-      SendError(err_msg, image_handle);
-      return HIAI_ERROR;
+  // model size given by image engine, used by rungs without own size
+  uint32_t base_width = image_handle->console_params.model_width;
+  uint32_t base_height = image_handle->console_params.model_height;
+
+  vector<Output> outputs;
+
+  // between keyframes, shift the keyframe mask instead of running network
+  bool keyframe = true;
+  bool propagate = (image_handle->image_info.mode == 0
+      && mask_propagator_->Enabled());
+  if (propagate) {
+    // host pre-processed frame is the crop region already
+    const ImageInfo &image_info = image_handle->image_info;
+    MaskPropagator::Region region = { kCapRoiLeft, kCapRoiUp,
+        kCapRoiRight - kCapRoiLeft + 1, kCapRoiDown - kCapRoiUp + 1 };
+    if (image_info.preprocessed) {
+      region = { 0, 0, (uint32_t) image_info.width,
+          (uint32_t) image_info.height };
     }
-  }
-  else {
-    if (!PreProcessPicture(image_handle, resized_image)) {
-      string err_msg = "Failed to deal file=" + image_handle->image_info.path
-          + ". Reason: resize image failed.";
-      SendError(err_msg, image_handle);
-      return HIAI_ERROR;
+    keyframe = mask_propagator_->Observe(image_info.data.get(),
+                                         image_info.width, image_info.height,
+                                         region);
+    if (mask_propagator_->Frames() % kKeyframeReportInterval == 0) {
+      INFO_LOG("--inference-- %s", mask_propagator_->ToString().c_str());
+    }
+    if (!keyframe) {
+      outputs.resize(1);
+      keyframe = !mask_propagator_->Propagate(outputs[0]);
+      image_handle->console_params.model_width =
+          mask_propagator_->MaskWidth();
+      image_handle->console_params.model_height =
+          mask_propagator_->MaskHeight();
+      image_handle->output_dims.width = mask_propagator_->MaskWidth();
+      image_handle->output_dims.height = mask_propagator_->MaskHeight();
     }
   }
-  
-
-  // inference
-  // cout << "--inference-- inference" << endl;
-  vector<shared_ptr<hiai::IAITensor>> output_data;
-  if (!Inference(resized_image, output_data)) {
-    string err_msg = "Failed to deal file=" + image_handle->image_info.path
-        + ". Reason: inference failed.";
-    SendError(err_msg, image_handle);
-    return HIAI_ERROR;
+  if (keyframe) {
+    HIAI_StatusT infer_ret = InferKeyframe(image_handle, base_width,
+                                           base_height, outputs);
+    if (infer_ret != HIAI_OK) {
+      return infer_ret;
+    }
+    if (propagate) {
+      uint32_t mask_width = 0;
+      uint32_t mask_height = 0;
+      MaskSize(*image_handle, mask_width, mask_height);
+      mask_propagator_->SetKeyframe(outputs[0], mask_width, mask_height);
+    }
   }
 
   // send result
   // cout << "--inference-- send to post engine" << endl;
-  if (!SendResult(image_handle, output_data)) {
+  if (!SendResult(image_handle, outputs)) {
     string err_msg = "Failed to deal file=" + image_handle->image_info.path
         + ". Reason: Inference SendData failed.";
     SendError(err_msg, image_handle);
@@ -43,7 +43,12 @@
 #include "hiaiengine/ai_tensor.h"
 #include "hiaiengine/status.h"
 
+#include "ascenddk/ascend_ezdvpp/dvpp_process.h"
 #include "data_type.h"
+#include "cascade_gate.h"
+#include "inference_cache.h"
+#include "mask_propagator.h"
+#include "resolution_controller.h"
 
 #define INPUT_SIZE 2
 #define OUTPUT_SIZE 1
@@ -81,8 +86,63 @@ public:
   HIAI_DEFINE_PROCESS(INPUT_SIZE, OUTPUT_SIZE);
 
 private:
-  // cache AI model parameters
-  std::shared_ptr<hiai::AIModelManager> ai_model_manager_;
+  /**
+   * @brief: one model of the resolution ladder
+   */
+  struct ModelRung {
+    std::string path;
+    // model input size, 0 means size given by console params; filled
+    // from the model at Init when it reports one
+    uint32_t width;
+    uint32_t height;
+    // output tensor dimensions reported by the model, 0 if unknown
+    OutputDims output;
+    std::shared_ptr<hiai::AIModelManager> ai_model_manager;
+  };
+
+  // loaded models, index 0 is the full resolution model
+  std::vector<ModelRung> models_;
+
+  // selects model of the ladder per frame
+  std::shared_ptr<ResolutionController> resolution_controller_;
+
+  // gates the full model behind the fast model, null when cascade is off
+  std::shared_ptr<CascadeGate> cascade_gate_;
+
+  // index of the cascade fast model in models_
+  uint32_t cascade_model_id_;
+
+  // keyframe scheduling and mask propagation (cap mode)
+  std::shared_ptr<MaskPropagator> mask_propagator_;
+
+  /**
+   * @brief: where crop and resize runs
+   */
+  enum PreprocessMode {
+    kPreprocessDvpp = 0,
+    // host SIMD kernel
+    kPreprocessCpu = 1,
+    // VPC, CPU when VPC fails
+    kPreprocessAuto = 2
+  };
+
+  /**
+   * @brief: crop and resize statistics of one path
+   */
+  struct PreprocessStat {
+    uint64_t frames = 0;
+    double total_ms = 0.0;
+  };
+
+  PreprocessMode preprocess_mode_;
+  PreprocessStat dvpp_stat_;
+  PreprocessStat cpu_stat_;
+
+  // number of frames inferred by the model
+  uint64_t frame_count_;
+
+  // cache of inference results, keyed by model input content
+  std::shared_ptr<InferenceCache> inference_cache_;
 
   /**
    * @brief: pre-process cap
@@ -93,6 +153,31 @@ private:
   bool PreProcessCap(const std::shared_ptr<EngineTrans> &image_handle,
                   hiai::ImageData<u_int8_t> &resized_image);
 
+  /**
+   * @brief: crop and resize by VPC or host kernel, per preprocess mode
+   * @param [in]: resize_para: crop and resize parameters
+   * @param [in]: image_handle: original image
+   * @param [out]: resized_image: NV12 output image
+   * @return: true: success; false: failed
+   */
+  bool CropResize(const ascend::utils::DvppBasicVpcPara &resize_para,
+                  const std::shared_ptr<EngineTrans> &image_handle,
+                  hiai::ImageData<u_int8_t> &resized_image);
+
+  /**
+   * @brief: crop and resize by ez_dvpp
+   */
+  bool DvppCropResize(const ascend::utils::DvppBasicVpcPara &resize_para,
+                      const std::shared_ptr<EngineTrans> &image_handle,
+                      hiai::ImageData<u_int8_t> &resized_image);
+
+  /**
+   * @brief: crop and resize by host SIMD kernel, same semantics as VPC
+   */
+  bool CpuCropResize(const ascend::utils::DvppBasicVpcPara &resize_para,
+                     const std::shared_ptr<EngineTrans> &image_handle,
+                     hiai::ImageData<u_int8_t> &resized_image);
+
   /**
    * @brief: pre-process picture
    * @param [in]: image_handle: original image
@@ -102,25 +187,79 @@ private:
   bool PreProcessPicture(const std::shared_ptr<EngineTrans> &image_handle,
                   hiai::ImageData<u_int8_t> &resized_image); 
 
+  /**
+   * @brief: parse model ladder, format: path:WxH,path:WxH,...
+   * @param [in]: value: config value
+   * @return: true: success; false: failed
+   */
+  bool ParseModelLadder(const std::string &value);
+
+  /**
+   * @brief: load every model of the ladder
+   * @param [in]: config: engine's parameters
+   * @return: true: success; false: failed
+   */
+  bool LoadModels(const hiai::AIConfig& config);
+
+  /**
+   * @brief: pre-process and inference one model, result may come from cache
+   * @param [in]: model_id: index of the model in models_
+   * @param [in]: image_handle: original image, model size is updated
+   * @param [in]: base_width: model width used when the model has no own size
+   * @param [in]: base_height: model height used when the model has no own size
+   * @param [out]: outputs: inference result
+   * @param [out]: service_ms: pre-process and inference time
+   * @param [out]: cache_hit: result came from cache or not
+   * @param [out]: reason: failure reason
+   * @return: true: success; false: failed
+   */
+  bool RunModel(uint32_t model_id, std::shared_ptr<EngineTrans> &image_handle,
+                uint32_t base_width, uint32_t base_height,
+                std::vector<Output> &outputs, double &service_ms,
+                bool &cache_hit, std::string &reason);
+
+  /**
+   * @brief: run network on a keyframe: cascade fast model if enabled,
+   *         then full model picked by the resolution ladder when needed
+   * @param [in]: image_handle: original image, model size is updated
+   * @param [in]: base_width: model width given by image engine
+   * @param [in]: base_height: model height given by image engine
+   * @param [out]: outputs: inference result
+   * @return: HIAI_StatusT, error has been sent to post engine when failed
+   */
+  HIAI_StatusT InferKeyframe(std::shared_ptr<EngineTrans> &image_handle,
+                             uint32_t base_width, uint32_t base_height,
+                             std::vector<Output> &outputs);
+
   /**
    * @brief: inference
+   * @param [in]: model_id: index of the model in models_
    * @param [in]: resized_image: ez_dvpp output image
    * @param [out]: output_data_vec: inference output
    * @return: true: success; false: failed
    */
   bool Inference(
-      const hiai::ImageData<u_int8_t> &resized_image,
+      uint32_t model_id, const hiai::ImageData<u_int8_t> &resized_image,
       std::vector<std::shared_ptr<hiai::IAITensor>> &output_data_vec);
 
+  /**
+   * @brief: copy inference output tensors to transferable outputs
+   * @param [in]: output_data_vec: inference output
+   * @param [out]: outputs: copied result
+   * @return: true: success; false: failed
+   */
+  bool ArrangeResult(
+      const std::vector<std::shared_ptr<hiai::IAITensor>> &output_data_vec,
+      std::vector<Output> &outputs);
+
   /**
    * @brief: send result
    * @param [in]: image_handle: engine transform data
-   * @param [in]: inference result
+   * @param [in]: outputs: inference result
    * @return: true: success; false: failed
    */
-  bool SendResult(
-      std::shared_ptr<EngineTrans> &image_handle,
-      std::vector<std::shared_ptr<hiai::IAITensor>> &output_data_vec);
+  bool SendResult(std::shared_ptr<EngineTrans> &image_handle,
+                  const std::vector<Output> &outputs);
 
   /**
    * @brief: send result
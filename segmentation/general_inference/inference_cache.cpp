@@ -0,0 +1,190 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "inference_cache.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+// 64-bit multiply-rotate hash constants (same as xxHash64)
+const uint64_t kPrime1 = 11400714785074694791ULL;
+const uint64_t kPrime2 = 14029467366897019727ULL;
+const uint64_t kPrime3 = 1609587929392839161ULL;
+const uint64_t kPrime4 = 9650029242287828579ULL;
+const uint64_t kPrime5 = 2870177450012600261ULL;
+
+// hash seed
+const uint64_t kHashSeed = 0;
+
+inline uint64_t Rotl(uint64_t value, uint32_t bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t Read64(const uint8_t *ptr) {
+  uint64_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+inline uint32_t Read32(const uint8_t *ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  acc = Rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t value) {
+  acc ^= Round(0, value);
+  return acc * kPrime1 + kPrime4;
+}
+}
+
+InferenceCache::InferenceCache(uint32_t capacity)
+    : capacity_(capacity),
+      lookups_(0),
+      hits_(0),
+      bytes_saved_(0) {
+}
+
+uint64_t InferenceCache::Hash(const uint8_t *data, uint32_t size) {
+  const uint8_t *ptr = data;
+  const uint8_t *end = data + size;
+  uint64_t hash;
+
+  if (size >= 32) {
+    // four independent lanes so that the multiplies can be pipelined
+    uint64_t v1 = kHashSeed + kPrime1 + kPrime2;
+    uint64_t v2 = kHashSeed + kPrime2;
+    uint64_t v3 = kHashSeed;
+    uint64_t v4 = kHashSeed - kPrime1;
+    const uint8_t *limit = end - 32;
+    do {
+      v1 = Round(v1, Read64(ptr));
+      v2 = Round(v2, Read64(ptr + 8));
+      v3 = Round(v3, Read64(ptr + 16));
+      v4 = Round(v4, Read64(ptr + 24));
+      ptr += 32;
+    } while (ptr <= limit);
+    hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+    hash = MergeRound(hash, v1);
+    hash = MergeRound(hash, v2);
+    hash = MergeRound(hash, v3);
+    hash = MergeRound(hash, v4);
+  } else {
+    hash = kHashSeed + kPrime5;
+  }
+  hash += size;
+
+  // tail bytes
+  for (; ptr + 8 <= end; ptr += 8) {
+    hash ^= Round(0, Read64(ptr));
+    hash = Rotl(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (ptr + 4 <= end) {
+    hash ^= uint64_t(Read32(ptr)) * kPrime1;
+    hash = Rotl(hash, 23) * kPrime2 + kPrime3;
+    ptr += 4;
+  }
+  for (; ptr < end; ++ptr) {
+    hash ^= (*ptr) * kPrime5;
+    hash = Rotl(hash, 11) * kPrime1;
+  }
+
+  // final avalanche
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+bool InferenceCache::Lookup(uint64_t hash, uint32_t model_id,
+                            uint32_t input_size, vector<Output> &outputs) {
+  if (!Enabled()) {
+    return false;
+  }
+  lookups_++;
+  Key key = { hash, model_id, input_size };
+  auto iter = index_.find(key);
+  if (iter == index_.end()) {
+    return false;
+  }
+
+  // move to front, list iterators stay valid
+  entries_.splice(entries_.begin(), entries_, iter->second);
+  outputs = iter->second->second;
+  hits_++;
+  bytes_saved_ += input_size;
+  return true;
+}
+
+void InferenceCache::Insert(uint64_t hash, uint32_t model_id,
+                            uint32_t input_size,
+                            const vector<Output> &outputs) {
+  if (!Enabled()) {
+    return;
+  }
+  Key key = { hash, model_id, input_size };
+  auto iter = index_.find(key);
+  if (iter != index_.end()) {
+    iter->second->second = outputs;
+    entries_.splice(entries_.begin(), entries_, iter->second);
+    return;
+  }
+
+  // evict least recently used
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(key, outputs);
+  index_[key] = entries_.begin();
+}
+
+string InferenceCache::ToString() const {
+  stringstream log_info_stream("");
+  double hit_rate = (lookups_ == 0) ? 0.0 : (double) hits_ / lookups_;
+  log_info_stream << "cache lookups:" << lookups_ << ", hits:" << hits_
+      << ", hit_rate:" << hit_rate * 100.0 << "%, bytes_saved:"
+      << bytes_saved_ << ", entries:" << entries_.size() << "/" << capacity_;
+  return log_info_stream.str();
+}
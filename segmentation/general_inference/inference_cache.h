@@ -0,0 +1,133 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_INFERENCE_INFERENCE_CACHE_H_
+#define GENERAL_INFERENCE_INFERENCE_CACHE_H_
+
+#include <list>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hiaiengine/data_type.h"
+#include "data_type.h"
+
+/**
+ * @brief: bounded LRU cache of inference results, keyed by the content hash
+ *         of the resized model input and the id of the model that produced it
+ */
+class InferenceCache {
+public:
+  /**
+   * @brief: constructor
+   * @param [in]: capacity: max number of cached results, 0 disables cache
+   */
+  explicit InferenceCache(uint32_t capacity);
+
+  /**
+   * @brief: fast non-cryptographic 64-bit hash of a buffer
+   * @param [in]: data: buffer address
+   * @param [in]: size: buffer size in bytes
+   * @return: hash value
+   */
+  static uint64_t Hash(const uint8_t *data, uint32_t size);
+
+  /**
+   * @brief: look up cached result, hit entry becomes most recently used
+   * @param [in]: hash: content hash of model input
+   * @param [in]: model_id: id of the model
+   * @param [in]: input_size: size of model input, guards hash collision
+   * @param [out]: outputs: cached inference result
+   * @return: true: hit; false: miss
+   */
+  bool Lookup(uint64_t hash, uint32_t model_id, uint32_t input_size,
+              std::vector<Output> &outputs);
+
+  /**
+   * @brief: insert result, the least recently used entry is evicted if full
+   * @param [in]: hash: content hash of model input
+   * @param [in]: model_id: id of the model
+   * @param [in]: input_size: size of model input
+   * @param [in]: outputs: inference result
+   */
+  void Insert(uint64_t hash, uint32_t model_id, uint32_t input_size,
+              const std::vector<Output> &outputs);
+
+  /**
+   * @brief: cache is enabled or not
+   */
+  bool Enabled() const {
+    return capacity_ > 0;
+  }
+
+  /**
+   * @brief: statistics string: lookups, hit rate, bytes saved
+   */
+  std::string ToString() const;
+
+  uint64_t Lookups() const {
+    return lookups_;
+  }
+
+private:
+  struct Key {
+    uint64_t hash;
+    uint32_t model_id;
+    uint32_t input_size;
+    bool operator==(const Key &other) const {
+      return hash == other.hash && model_id == other.model_id
+          && input_size == other.input_size;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return static_cast<size_t>(key.hash ^ (uint64_t(key.model_id) << 32));
+    }
+  };
+
+  typedef std::pair<Key, std::vector<Output>> Entry;
+
+  uint32_t capacity_;
+  // most recently used entry at front
+  std::list<Entry> entries_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+  uint64_t lookups_;
+  uint64_t hits_;
+  // model input bytes not sent to the model thanks to cache hit
+  uint64_t bytes_saved_;
+};
+
+#endif /* GENERAL_INFERENCE_INFERENCE_CACHE_H_ */
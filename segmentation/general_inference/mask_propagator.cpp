@@ -0,0 +1,264 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "mask_propagator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+// projections sample every N pixels of the crop region
+const int32_t kProjectionStep = 2;
+
+// search range of the motion estimate (unit: frame pixels)
+const int32_t kSearchRange = 32;
+
+// weight of the newest sample in the smoothed motion
+const float kMotionWeight = 0.25f;
+
+// motion below this is treated as still (unit: frame pixels)
+const float kMinMotion = 0.5f;
+}
+
+MaskPropagator::MaskPropagator(uint32_t max_interval, uint32_t min_interval,
+                               float max_drift, bool planar)
+    : max_interval_(max_interval),
+      min_interval_(max(1u, min(min_interval, max_interval))),
+      max_drift_(max_drift),
+      planar_(planar),
+      region_({ 0, 0, 0, 0 }),
+      mask_width_(0),
+      mask_height_(0),
+      mask_channels_(0),
+      drift_x_(0),
+      drift_y_(0),
+      motion_(0.0f),
+      interval_(min_interval_),
+      frames_since_key_(0),
+      frames_(0),
+      keyframes_(0) {
+}
+
+void MaskPropagator::BuildProjections(const uint8_t *luma, uint32_t width,
+                                      vector<int32_t> &rows,
+                                      vector<int32_t> &cols) const {
+  uint32_t row_bins = region_.height / kProjectionStep;
+  uint32_t col_bins = region_.width / kProjectionStep;
+  rows.assign(row_bins, 0);
+  cols.assign(col_bins, 0);
+
+  // single pass over sampled rows, columns accumulate row by row
+  for (uint32_t r = 0; r < row_bins; r++) {
+    const uint8_t *line = luma + (region_.top + r * kProjectionStep) * width
+        + region_.left;
+    int32_t row_sum = 0;
+    for (uint32_t c = 0; c < col_bins; c++) {
+      int32_t value = line[c * kProjectionStep];
+      row_sum += value;
+      cols[c] += value;
+    }
+    rows[r] = row_sum;
+  }
+
+  // remove mean so that exposure change does not look like motion
+  int64_t row_total = 0;
+  for (int32_t value : rows) {
+    row_total += value;
+  }
+  int32_t row_mean = row_bins > 0 ? row_total / row_bins : 0;
+  for (int32_t &value : rows) {
+    value -= row_mean;
+  }
+  int64_t col_total = 0;
+  for (int32_t value : cols) {
+    col_total += value;
+  }
+  int32_t col_mean = col_bins > 0 ? col_total / col_bins : 0;
+  for (int32_t &value : cols) {
+    value -= col_mean;
+  }
+}
+
+int32_t MaskPropagator::MatchShift(const vector<int32_t> &current,
+                                   const vector<int32_t> &previous,
+                                   int32_t range) {
+  int32_t size = current.size();
+  int32_t best_shift = 0;
+  int64_t best_cost = numeric_limits<int64_t>::max();
+  for (int32_t shift = -range; shift <= range; shift++) {
+    // current[i] ~ previous[i - shift] over the overlapping part
+    int32_t begin = max(0, shift);
+    int32_t end = min(size, size + shift);
+    if (end - begin <= size / 2) {
+      continue;
+    }
+    int64_t sad = 0;
+    for (int32_t i = begin; i < end; i++) {
+      sad += abs(current[i] - previous[i - shift]);
+    }
+    // normalize by overlap, prefer the smaller shift on ties
+    int64_t cost = sad * 1024 / (end - begin);
+    if (cost < best_cost || (cost == best_cost
+        && abs(shift) < abs(best_shift))) {
+      best_cost = cost;
+      best_shift = shift;
+    }
+  }
+  return best_shift;
+}
+
+bool MaskPropagator::Observe(const uint8_t *luma, uint32_t width,
+                             uint32_t height, const Region &region) {
+  frames_++;
+  if (luma == nullptr || region.left + region.width > width
+      || region.top + region.height > height) {
+    return true;
+  }
+  if (region.left != region_.left || region.top != region_.top
+      || region.width != region_.width || region.height != region_.height) {
+    region_ = region;
+    prev_rows_.clear();
+    prev_cols_.clear();
+    mask_width_ = 0;
+  }
+
+  BuildProjections(luma, width, rows_, cols_);
+  if (prev_rows_.size() == rows_.size() && prev_cols_.size() == cols_.size()) {
+    int32_t range = kSearchRange / kProjectionStep;
+    int32_t dx = MatchShift(cols_, prev_cols_, range) * kProjectionStep;
+    int32_t dy = MatchShift(rows_, prev_rows_, range) * kProjectionStep;
+    drift_x_ += dx;
+    drift_y_ += dy;
+    motion_ += kMotionWeight * (abs(dx) + abs(dy) - motion_);
+  }
+  prev_rows_.swap(rows_);
+  prev_cols_.swap(cols_);
+
+  frames_since_key_++;
+  float drift = abs(drift_x_) + abs(drift_y_);
+  return mask_width_ == 0 || frames_since_key_ >= interval_
+      || drift > max_drift_;
+}
+
+void MaskPropagator::SetKeyframe(const Output &mask, uint32_t mask_width,
+                                 uint32_t mask_height) {
+  uint32_t pixels = mask_width * mask_height;
+  if (pixels == 0 || mask.data == nullptr) {
+    mask_width_ = 0;
+    return;
+  }
+  key_mask_ = mask;
+  mask_width_ = mask_width;
+  mask_height_ = mask_height;
+  mask_channels_ = mask.size / (pixels * sizeof(float));
+  drift_x_ = 0;
+  drift_y_ = 0;
+  frames_since_key_ = 0;
+  keyframes_++;
+
+  // more motion, shorter interval, so that drift stays below the limit
+  float frames_to_drift = max_drift_ / max(motion_, kMinMotion);
+  interval_ = static_cast<uint32_t>(frames_to_drift);
+  interval_ = max(min_interval_, min(max_interval_, interval_));
+}
+
+bool MaskPropagator::Propagate(Output &mask) {
+  if (mask_width_ == 0 || mask_channels_ == 0) {
+    return false;
+  }
+  // motion in frame pixels to mask pixels
+  int32_t width = mask_width_;
+  int32_t height = mask_height_;
+  int32_t shift_x = lround((double) drift_x_ * width / region_.width);
+  int32_t shift_y = lround((double) drift_y_ * height / region_.height);
+  shift_x = max(-width + 1, min(width - 1, shift_x));
+  shift_y = max(-height + 1, min(height - 1, shift_y));
+
+  mask.size = key_mask_.size;
+  mask.data = shared_ptr<uint8_t>(new (nothrow) uint8_t[mask.size],
+                                  default_delete<uint8_t[]>());
+  if (mask.data == nullptr) {
+    return false;
+  }
+
+  // dst(x, y) = key(x - shift_x, y - shift_y), border replicated; CHW
+  // shifts each channel plane, HWC the one plane of whole pixels
+  uint32_t planes = planar_ ? mask_channels_ : 1;
+  uint32_t pixel_bytes = (planar_ ? 1 : mask_channels_) * sizeof(float);
+  uint32_t row_bytes = width * pixel_bytes;
+  for (uint32_t plane = 0; plane < planes; plane++) {
+    const uint8_t *src = key_mask_.data.get() + plane * height * row_bytes;
+    uint8_t *dst = mask.data.get() + plane * height * row_bytes;
+    ShiftPlane(src, dst, width, height, pixel_bytes, shift_x, shift_y);
+  }
+  return true;
+}
+
+void MaskPropagator::ShiftPlane(const uint8_t *src, uint8_t *dst,
+                                int32_t width, int32_t height,
+                                uint32_t pixel_bytes, int32_t shift_x,
+                                int32_t shift_y) {
+  uint32_t row_bytes = width * pixel_bytes;
+  int32_t inner_begin = max(0, shift_x);
+  int32_t inner_end = min(width, width + shift_x);
+  for (int32_t y = 0; y < height; y++) {
+    int32_t src_y = max(0, min(height - 1, y - shift_y));
+    const uint8_t *src_row = src + src_y * row_bytes;
+    uint8_t *dst_row = dst + y * row_bytes;
+    memcpy(dst_row + inner_begin * pixel_bytes,
+           src_row + (inner_begin - shift_x) * pixel_bytes,
+           (inner_end - inner_begin) * pixel_bytes);
+    for (int32_t x = 0; x < inner_begin; x++) {
+      memcpy(dst_row + x * pixel_bytes, src_row, pixel_bytes);
+    }
+    for (int32_t x = inner_end; x < width; x++) {
+      memcpy(dst_row + x * pixel_bytes, src_row + (width - 1) * pixel_bytes,
+             pixel_bytes);
+    }
+  }
+}
+
+string MaskPropagator::ToString() const {
+  stringstream log_info_stream("");
+  double key_rate = (frames_ == 0) ? 0.0 : (double) keyframes_ / frames_;
+  log_info_stream << "keyframe frames:" << frames_ << ", keyframes:"
+      << keyframes_ << ", keyframe_rate:" << key_rate * 100.0
+      << "%, interval:" << interval_ << ", motion:" << motion_;
+  return log_info_stream.str();
+}
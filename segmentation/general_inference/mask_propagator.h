@@ -0,0 +1,179 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_INFERENCE_MASK_PROPAGATOR_H_
+#define GENERAL_INFERENCE_MASK_PROPAGATOR_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "hiaiengine/data_type.h"
+#include "data_type.h"
+
+/**
+ * @brief: keyframe scheduling and mask propagation between keyframes.
+ *         global motion of the crop region is estimated per frame by
+ *         matching row and column luma projections of the NV12 frame,
+ *         the keyframe mask is shifted by the motion accumulated since
+ *         the keyframe. keyframe interval adapts to the measured motion
+ */
+class MaskPropagator {
+public:
+  /**
+   * @brief: crop region of the camera frame that the mask covers
+   */
+  struct Region {
+    uint32_t left;
+    uint32_t top;
+    uint32_t width;
+    uint32_t height;
+  };
+
+  /**
+   * @brief: constructor
+   * @param [in]: max_interval: max frames per keyframe, 1 disables
+   * @param [in]: min_interval: min frames per keyframe
+   * @param [in]: max_drift: max motion since keyframe (unit: frame pixels)
+   * @param [in]: planar: mask layout is CHW, else HWC
+   */
+  MaskPropagator(uint32_t max_interval, uint32_t min_interval,
+                 float max_drift, bool planar);
+
+  /**
+   * @brief: propagation is enabled or not
+   */
+  bool Enabled() const {
+    return max_interval_ > 1;
+  }
+
+  /**
+   * @brief: estimate motion against previous frame
+   * @param [in]: luma: Y plane of NV12 frame
+   * @param [in]: width: frame width, also Y plane stride
+   * @param [in]: height: frame height
+   * @param [in]: region: region of the frame that the mask covers,
+   *              a new region restarts from a keyframe
+   * @return: true: network must run on this frame; false: propagate
+   */
+  bool Observe(const uint8_t *luma, uint32_t width, uint32_t height,
+               const Region &region);
+
+  /**
+   * @brief: keep network result of this frame as keyframe mask
+   * @param [in]: mask: inference output, float, layout as constructed
+   * @param [in]: mask_width: mask width
+   * @param [in]: mask_height: mask height
+   */
+  void SetKeyframe(const Output &mask, uint32_t mask_width,
+                   uint32_t mask_height);
+
+  /**
+   * @brief: shift keyframe mask by the motion since keyframe
+   * @param [out]: mask: propagated mask, same shape as keyframe mask
+   * @return: true: success; false: no keyframe or new buffer failed
+   */
+  bool Propagate(Output &mask);
+
+  uint32_t MaskWidth() const {
+    return mask_width_;
+  }
+
+  uint32_t MaskHeight() const {
+    return mask_height_;
+  }
+
+  uint64_t Frames() const {
+    return frames_;
+  }
+
+  /**
+   * @brief: statistics string: keyframe rate, interval, motion
+   */
+  std::string ToString() const;
+
+private:
+  /**
+   * @brief: row and column luma projections of the crop region,
+   *         sampled every kProjectionStep pixels, mean removed
+   */
+  void BuildProjections(const uint8_t *luma, uint32_t width,
+                        std::vector<int32_t> &rows,
+                        std::vector<int32_t> &cols) const;
+
+  /**
+   * @brief: shift (unit: projection bins) that best aligns previous
+   *         projection with current one, by mean absolute difference
+   */
+  static int32_t MatchShift(const std::vector<int32_t> &current,
+                            const std::vector<int32_t> &previous,
+                            int32_t range);
+
+  /**
+   * @brief: shift one plane of pixels, border replicated
+   */
+  static void ShiftPlane(const uint8_t *src, uint8_t *dst, int32_t width,
+                         int32_t height, uint32_t pixel_bytes,
+                         int32_t shift_x, int32_t shift_y);
+
+  uint32_t max_interval_;
+  uint32_t min_interval_;
+  float max_drift_;
+  bool planar_;
+  Region region_;
+
+  // projections of the previous frame
+  std::vector<int32_t> prev_rows_;
+  std::vector<int32_t> prev_cols_;
+  std::vector<int32_t> rows_;
+  std::vector<int32_t> cols_;
+
+  // keyframe mask
+  Output key_mask_;
+  uint32_t mask_width_;
+  uint32_t mask_height_;
+  uint32_t mask_channels_;
+
+  // motion accumulated since keyframe (unit: frame pixels)
+  int32_t drift_x_;
+  int32_t drift_y_;
+  // smoothed per frame motion magnitude (unit: frame pixels)
+  float motion_;
+  uint32_t interval_;
+  uint32_t frames_since_key_;
+
+  uint64_t frames_;
+  uint64_t keyframes_;
+};
+
+#endif /* GENERAL_INFERENCE_MASK_PROPAGATOR_H_ */
@@ -0,0 +1,100 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "resolution_controller.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace {
+// weight of the newest sample in the smoothed service time
+const double kEwmaWeight = 0.25;
+}
+
+ResolutionController::ResolutionController(
+    const vector<uint32_t> &level_pixels, double budget_ms, double hysteresis,
+    uint32_t dwell_frames)
+    : level_pixels_(level_pixels),
+      budget_ms_(budget_ms),
+      hysteresis_(hysteresis),
+      dwell_frames_(dwell_frames),
+      level_(0),
+      ewma_ms_(0.0),
+      frames_at_level_(0),
+      switches_(0) {
+}
+
+void ResolutionController::SwitchTo(uint32_t level) {
+  level_ = level;
+  ewma_ms_ = 0.0;
+  frames_at_level_ = 0;
+  switches_++;
+}
+
+void ResolutionController::Update(double service_ms) {
+  if (frames_at_level_ == 0) {
+    ewma_ms_ = service_ms;
+  } else {
+    ewma_ms_ += kEwmaWeight * (service_ms - ewma_ms_);
+  }
+  frames_at_level_++;
+
+  if (budget_ms_ <= 0.0 || level_pixels_.size() < 2
+      || frames_at_level_ < dwell_frames_) {
+    return;
+  }
+
+  // too slow, go to a cheaper level
+  if (ewma_ms_ > budget_ms_ && level_ + 1 < level_pixels_.size()) {
+    SwitchTo(level_ + 1);
+    return;
+  }
+
+  // service time scales roughly with input pixels
+  if (level_ > 0 && level_pixels_[level_] > 0) {
+    double predicted_ms = ewma_ms_ * level_pixels_[level_ - 1]
+        / level_pixels_[level_];
+    if (predicted_ms < budget_ms_ * (1.0 - hysteresis_)) {
+      SwitchTo(level_ - 1);
+    }
+  }
+}
+
+string ResolutionController::ToString() const {
+  stringstream log_info_stream("");
+  log_info_stream << "ladder level:" << level_ << "/" << level_pixels_.size()
+      << ", service_ms:" << ewma_ms_ << ", budget_ms:" << budget_ms_
+      << ", switches:" << switches_;
+  return log_info_stream.str();
+}
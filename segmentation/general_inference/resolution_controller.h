@@ -0,0 +1,94 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_INFERENCE_RESOLUTION_CONTROLLER_H_
+#define GENERAL_INFERENCE_RESOLUTION_CONTROLLER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief: picks a level of the model resolution ladder per frame
+ *         level 0 is the full resolution model, higher levels are cheaper.
+ *         step down when smoothed service time exceeds the latency budget,
+ *         step up only when the predicted cost of the next higher level
+ *         stays under budget * (1 - hysteresis)
+ */
+class ResolutionController {
+public:
+  /**
+   * @brief: constructor
+   * @param [in]: level_pixels: model input pixels of every level
+   * @param [in]: budget_ms: latency budget, 0 keeps level 0
+   * @param [in]: hysteresis: fraction of budget kept free before step up
+   * @param [in]: dwell_frames: min frames measured before next switch
+   */
+  ResolutionController(const std::vector<uint32_t> &level_pixels,
+                       double budget_ms, double hysteresis,
+                       uint32_t dwell_frames);
+
+  /**
+   * @brief: current level
+   */
+  uint32_t Level() const {
+    return level_;
+  }
+
+  /**
+   * @brief: feed measured service time of a frame at current level
+   * @param [in]: service_ms: pre-process and inference time
+   */
+  void Update(double service_ms);
+
+  /**
+   * @brief: statistics string
+   */
+  std::string ToString() const;
+
+private:
+  void SwitchTo(uint32_t level);
+
+  std::vector<uint32_t> level_pixels_;
+  double budget_ms_;
+  double hysteresis_;
+  uint32_t dwell_frames_;
+
+  uint32_t level_;
+  // smoothed service time at current level
+  double ewma_ms_;
+  uint32_t frames_at_level_;
+  uint64_t switches_;
+};
+
+#endif /* GENERAL_INFERENCE_RESOLUTION_CONTROLLER_H_ */
@@ -0,0 +1,124 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "bev_kernel.h"
+
+#include <cmath>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+
+namespace bev {
+
+namespace {
+const int32_t kTapSize = 1 << kTapBits;
+const uint32_t kTapMask = kTapSize - 1;
+
+// round half to even as cv::saturate_cast<int>(double)
+int32_t SaturateRound(double value) {
+  value = std::min(std::max(value, static_cast<double>(INT_MIN)),
+                   static_cast<double>(INT_MAX));
+  return static_cast<int32_t>(lrint(value));
+}
+}
+
+bool ParseHomography(const std::string &value, double matrix[9]) {
+  std::stringstream entries(value);
+  std::string entry;
+  uint32_t count = 0;
+  while (std::getline(entries, entry, ',')) {
+    if (count >= 9) {
+      return false;
+    }
+    matrix[count++] = atof(entry.c_str());
+  }
+  return count == 9;
+}
+
+bool BuildTable(const double matrix[9], uint32_t mask_width,
+                uint32_t mask_height, uint32_t width, uint32_t height,
+                std::vector<uint32_t> &table) {
+  uint32_t step = PaddedStep(mask_width);
+  // offset keeps 32 - 2 * kTapBits bits
+  if (static_cast<uint64_t>(step) * (mask_height + 2)
+      > (1u << (32 - 2 * kTapBits)) - 1) {
+    return false;
+  }
+  table.resize(width * height);
+  for (uint32_t v = 0; v < height; v++) {
+    double x0 = matrix[1] * v + matrix[2];
+    double y0 = matrix[4] * v + matrix[5];
+    double w0 = matrix[7] * v + matrix[8];
+    for (uint32_t u = 0; u < width; u++) {
+      double w = w0 + matrix[6] * u;
+      w = (w != 0.0) ? kTapSize / w : 0.0;
+      int32_t x = SaturateRound((x0 + matrix[0] * u) * w);
+      int32_t y = SaturateRound((y0 + matrix[3] * u) * w);
+      int32_t left = x >> kTapBits;
+      int32_t top = y >> kTapBits;
+      uint32_t &tap = table[v * width + u];
+      // a pixel of the 2x2 block must be in the mask
+      if (left < -1 || left >= static_cast<int32_t>(mask_width)
+          || top < -1 || top >= static_cast<int32_t>(mask_height)) {
+        tap = kInvalidTap;
+        continue;
+      }
+      uint32_t offset = (top + 1) * step + (left + 1);
+      tap = (offset << (2 * kTapBits)) | ((y & kTapMask) << kTapBits)
+          | (x & kTapMask);
+    }
+  }
+  return true;
+}
+
+void Gather(const uint32_t *table, const uint8_t *padded, uint32_t step,
+            uint8_t *cells, uint32_t count) {
+  for (uint32_t index = 0; index < count; index++) {
+    uint32_t tap = table[index];
+    if (tap == kInvalidTap) {
+      cells[index] = 0;
+      continue;
+    }
+    const uint8_t *pixel = padded + (tap >> (2 * kTapBits));
+    uint32_t fx = tap & kTapMask;
+    uint32_t fy = (tap >> kTapBits) & kTapMask;
+    // weights sum to 1 << (2 * kTapBits)
+    uint32_t top = pixel[0] * (kTapSize - fx) + pixel[1] * fx;
+    uint32_t bottom = pixel[step] * (kTapSize - fx) + pixel[step + 1] * fx;
+    cells[index] = static_cast<uint8_t>(
+        (top * (kTapSize - fy) + bottom * fy + (1u << (2 * kTapBits - 1)))
+        >> (2 * kTapBits));
+  }
+}
+
+}  // namespace bev
@@ -0,0 +1,100 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_BEV_KERNEL_H_
+#define GENERAL_POST_BEV_KERNEL_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief: bird's-eye-view projection of the 8-bit road mask by a table
+ *         built once from the homography. Same arithmetic as
+ *         cv::warpPerspective(mask, bev, h, size, INTER_LINEAR |
+ *         WARP_INVERSE_MAP, BORDER_CONSTANT, 0): source position rounded
+ *         to 1/32 pixel, bilinear weights of 10 bits in total
+ */
+namespace bev {
+
+// fractional bits of source position
+const uint32_t kTapBits = 5;
+
+// cell outside the mask, projects to 0
+const uint32_t kInvalidTap = 0xFFFFFFFFu;
+
+/**
+ * @brief: parse 9 comma separated values of a row-major 3x3 matrix
+ * @param [in]: value: matrix string
+ * @param [out]: matrix: parsed matrix
+ * @return: true: success; false: not 9 values
+ */
+bool ParseHomography(const std::string &value, double matrix[9]);
+
+/**
+ * @brief: bytes per row of the padded mask Gather reads, 1 pixel of 0
+ *         around the mask
+ */
+inline uint32_t PaddedStep(uint32_t mask_width) {
+  return mask_width + 2;
+}
+
+/**
+ * @brief: one tap per cell, index of top-left pixel in the padded mask
+ *         << 10 | y fraction << 5 | x fraction, or kInvalidTap
+ * @param [in]: matrix: homography from cell (u, v) to mask (x, y)
+ * @param [in]: mask_width: mask width
+ * @param [in]: mask_height: mask height
+ * @param [in]: width: cells per row
+ * @param [in]: height: rows of cells
+ * @param [out]: table: width * height taps
+ * @return: true: success; false: padded mask too large to index
+ */
+bool BuildTable(const double matrix[9], uint32_t mask_width,
+                uint32_t mask_height, uint32_t width, uint32_t height,
+                std::vector<uint32_t> &table);
+
+/**
+ * @brief: project cells through their taps
+ * @param [in]: table: taps of cells
+ * @param [in]: padded: padded mask, PaddedStep bytes per row
+ * @param [in]: step: bytes per padded row
+ * @param [out]: cells: projected 8-bit values
+ * @param [in]: count: cells
+ */
+void Gather(const uint32_t *table, const uint8_t *padded, uint32_t step,
+            uint8_t *cells, uint32_t count);
+
+}  // namespace bev
+
+#endif /* GENERAL_POST_BEV_KERNEL_H_ */
@@ -0,0 +1,205 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "class_kernel.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "overlay_kernel.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CLASS_KERNEL_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CLASS_KERNEL_SSE2 1
+#endif
+
+namespace classmap {
+
+namespace {
+// rounding of the >> 8
+const uint16_t kRound = 128;
+
+void SetUndrawn(Palette &palette, uint32_t index) {
+  palette.mask[index][0] = 0;
+  palette.mask[index][1] = 0;
+  palette.mask[index][2] = 0;
+  palette.image_weight[index] = 256;
+}
+}
+
+bool ParsePalette(const std::string &value, bool bgr, Palette &palette) {
+  for (uint32_t index = 0; index < kMaxClasses; ++index) {
+    SetUndrawn(palette, index);
+  }
+  std::stringstream entries(value);
+  std::string entry;
+  uint32_t index = 0;
+  while (std::getline(entries, entry, ';')) {
+    if (index >= kMaxClasses) {
+      return false;
+    }
+    if (entry == "-") {
+      index++;
+      continue;
+    }
+    int32_t colour[3] = { 0, 0, 0 };
+    std::stringstream channels(entry);
+    std::string channel;
+    uint32_t count = 0;
+    while (std::getline(channels, channel, ',')) {
+      if (count >= 3) {
+        return false;
+      }
+      colour[count++] = atoi(channel.c_str());
+    }
+    if (count != 3) {
+      return false;
+    }
+    for (uint32_t k = 0; k < 3; ++k) {
+      if (colour[k] < 0 || colour[k] > 255) {
+        return false;
+      }
+      uint32_t dst = bgr ? 2 - k : k;
+      palette.mask[index][dst] = static_cast<uint16_t>(
+          overlay::kMaskWeight * colour[k] + kRound);
+    }
+    palette.image_weight[index] = overlay::kImageWeight;
+    index++;
+  }
+  return true;
+}
+
+void ArgmaxPlanar(const float *prob, uint32_t plane_stride,
+                  uint32_t channels, uint32_t width, uint8_t *index) {
+  uint32_t x = 0;
+#if defined(CLASS_KERNEL_NEON)
+  for (; x + 8 <= width; x += 8) {
+    float32x4_t best0 = vld1q_f32(prob + x);
+    float32x4_t best1 = vld1q_f32(prob + x + 4);
+    uint32x4_t class0 = vdupq_n_u32(0);
+    uint32x4_t class1 = vdupq_n_u32(0);
+    for (uint32_t c = 1; c < channels; ++c) {
+      const float *plane = prob + c * plane_stride + x;
+      float32x4_t v0 = vld1q_f32(plane);
+      float32x4_t v1 = vld1q_f32(plane + 4);
+      uint32x4_t gt0 = vcgtq_f32(v0, best0);
+      uint32x4_t gt1 = vcgtq_f32(v1, best1);
+      uint32x4_t cv = vdupq_n_u32(c);
+      best0 = vbslq_f32(gt0, v0, best0);
+      best1 = vbslq_f32(gt1, v1, best1);
+      class0 = vbslq_u32(gt0, cv, class0);
+      class1 = vbslq_u32(gt1, cv, class1);
+    }
+    uint16x8_t class16 = vcombine_u16(vmovn_u32(class0), vmovn_u32(class1));
+    vst1_u8(index + x, vmovn_u16(class16));
+  }
+#elif defined(CLASS_KERNEL_SSE2)
+  for (; x + 8 <= width; x += 8) {
+    __m128 best0 = _mm_loadu_ps(prob + x);
+    __m128 best1 = _mm_loadu_ps(prob + x + 4);
+    __m128i class0 = _mm_setzero_si128();
+    __m128i class1 = _mm_setzero_si128();
+    for (uint32_t c = 1; c < channels; ++c) {
+      const float *plane = prob + c * plane_stride + x;
+      __m128 v0 = _mm_loadu_ps(plane);
+      __m128 v1 = _mm_loadu_ps(plane + 4);
+      __m128 gt0 = _mm_cmpgt_ps(v0, best0);
+      __m128 gt1 = _mm_cmpgt_ps(v1, best1);
+      __m128i cv = _mm_set1_epi32(c);
+      best0 = _mm_or_ps(_mm_and_ps(gt0, v0), _mm_andnot_ps(gt0, best0));
+      best1 = _mm_or_ps(_mm_and_ps(gt1, v1), _mm_andnot_ps(gt1, best1));
+      __m128i m0 = _mm_castps_si128(gt0);
+      __m128i m1 = _mm_castps_si128(gt1);
+      class0 = _mm_or_si128(_mm_and_si128(m0, cv),
+                            _mm_andnot_si128(m0, class0));
+      class1 = _mm_or_si128(_mm_and_si128(m1, cv),
+                            _mm_andnot_si128(m1, class1));
+    }
+    // classes below 256, signed packs do not saturate
+    __m128i class16 = _mm_packs_epi32(class0, class1);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(index + x),
+                     _mm_packus_epi16(class16, class16));
+  }
+#endif
+  for (; x < width; x++) {
+    float best = prob[x];
+    uint32_t best_class = 0;
+    for (uint32_t c = 1; c < channels; ++c) {
+      float value = prob[c * plane_stride + x];
+      if (value > best) {
+        best = value;
+        best_class = c;
+      }
+    }
+    index[x] = static_cast<uint8_t>(best_class);
+  }
+}
+
+void ArgmaxInterleaved(const float *prob, uint32_t channels, uint32_t width,
+                       uint8_t *index, float *scratch) {
+  // one linear read of the row, planes stay in L1 for the argmax
+  for (uint32_t x = 0; x < width; x++) {
+    const float *pixel = prob + x * channels;
+    for (uint32_t c = 0; c < channels; ++c) {
+      scratch[c * width + x] = pixel[c];
+    }
+  }
+  ArgmaxPlanar(scratch, width, channels, width, index);
+}
+
+void Upsample2x(const uint8_t *index, uint8_t *out, uint32_t width) {
+  for (uint32_t x = 0; x < width; x++) {
+    out[x * 2] = index[x];
+    out[x * 2 + 1] = index[x];
+  }
+}
+
+void Colorize(const uint8_t *index, const Palette &palette,
+              const uint8_t *src, uint8_t *dst, uint32_t width) {
+  for (uint32_t x = 0; x < width; x++) {
+    uint32_t c = index[x];
+    uint32_t weight = palette.image_weight[c];
+    const uint16_t *mask = palette.mask[c];
+    const uint8_t *pixel = src + x * 3;
+    uint8_t *out = dst + x * 3;
+    out[0] = static_cast<uint8_t>((mask[0] + weight * pixel[0]) >> 8);
+    out[1] = static_cast<uint8_t>((mask[1] + weight * pixel[1]) >> 8);
+    out[2] = static_cast<uint8_t>((mask[2] + weight * pixel[2]) >> 8);
+  }
+}
+
+}  // namespace classmap
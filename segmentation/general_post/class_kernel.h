@@ -0,0 +1,119 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_CLASS_KERNEL_H_
+#define GENERAL_POST_CLASS_KERNEL_H_
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief: class map of multi-class outputs: per pixel argmax over C
+ *         channels, colourized by a palette and blended onto the image
+ *         with the same 102/154 weights as the road overlay
+ */
+namespace classmap {
+
+const uint32_t kMaxClasses = 256;
+
+/**
+ * @brief: palette in image channel order, premultiplied for the blend:
+ *         out = (mask + image_weight * in) >> 8
+ */
+struct Palette {
+  uint16_t mask[kMaxClasses][3];
+  uint16_t image_weight[kMaxClasses];
+};
+
+/**
+ * @brief: parse palette "r,g,b;r,g,b;-;..." one entry per class from
+ *         class 0, "-" leaves a class undrawn; classes past the list are
+ *         undrawn too
+ * @param [in]: value: palette string
+ * @param [in]: bgr: image is BGR, swap entries
+ * @param [out]: palette: parsed palette
+ * @return: true: success; false: malformed entry
+ */
+bool ParsePalette(const std::string &value, bool bgr, Palette &palette);
+
+/**
+ * @brief: scratch bytes needed by ArgmaxInterleaved and the class rows
+ */
+inline uint32_t ScratchSize(uint32_t channels, uint32_t width) {
+  return channels * width * 4 + width * 4 + 64;
+}
+
+/**
+ * @brief: argmax over planar channels (NCHW), first maximum wins
+ * @param [in]: prob: channel 0 of first pixel
+ * @param [in]: plane_stride: floats between channels
+ * @param [in]: channels: channels, at most kMaxClasses
+ * @param [in]: width: pixels
+ * @param [out]: index: class of each pixel
+ */
+void ArgmaxPlanar(const float *prob, uint32_t plane_stride,
+                  uint32_t channels, uint32_t width, uint8_t *index);
+
+/**
+ * @brief: argmax over interleaved channels (NHWC); the row is transposed
+ *         to planar in scratch first so channels are traversed linearly
+ * @param [in]: prob: channel 0 of first pixel
+ * @param [in]: channels: channels, at most kMaxClasses
+ * @param [in]: width: pixels
+ * @param [out]: index: class of each pixel
+ * @param [in]: scratch: channels * width floats
+ */
+void ArgmaxInterleaved(const float *prob, uint32_t channels, uint32_t width,
+                       uint8_t *index, float *scratch);
+
+/**
+ * @brief: nearest 2x upsample of a class row
+ * @param [in]: index: width classes
+ * @param [out]: out: 2 * width classes
+ */
+void Upsample2x(const uint8_t *index, uint8_t *out, uint32_t width);
+
+/**
+ * @brief: blend palette colour of each class onto an image row
+ * @param [in]: index: class of each pixel
+ * @param [in]: palette: palette in image channel order
+ * @param [in]: src: image row, 3 channels interleaved
+ * @param [out]: dst: output row, may be the same as src
+ * @param [in]: width: pixels
+ */
+void Colorize(const uint8_t *index, const Palette &palette,
+              const uint8_t *src, uint8_t *dst, uint32_t width);
+
+}  // namespace classmap
+
+#endif /* GENERAL_POST_CLASS_KERNEL_H_ */
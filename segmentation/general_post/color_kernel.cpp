@@ -0,0 +1,131 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "color_kernel.h"
+
+namespace color {
+
+namespace {
+// ITU-R BT.601 coefficients of OpenCV yuv420sp conversion, 20-bit
+const int32_t kShift = 20;
+const int32_t kHalf = 1 << (kShift - 1);
+const int32_t kCy = 1220542;
+const int32_t kCub = 2116026;
+const int32_t kCug = -409993;
+const int32_t kCvg = -852492;
+const int32_t kCvr = 1673527;
+
+inline int32_t Saturate(int32_t value) {
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+inline int32_t Luma(uint8_t y) {
+  int32_t value = static_cast<int32_t>(y) - 16;
+  return (value < 0 ? 0 : value) * kCy;
+}
+}
+
+bool Nv21RegionToRgbHalf(const uint8_t *yuv, uint32_t width, uint32_t height,
+                         uint32_t left, uint32_t top, uint8_t *dst,
+                         uint32_t dst_width, uint32_t dst_height,
+                         uint32_t dst_step) {
+  if (yuv == nullptr || dst == nullptr || (left & 1) != 0 || (top & 1) != 0
+      || left + dst_width * 2 > width || top + dst_height * 2 > height) {
+    return false;
+  }
+  const uint8_t *vu_plane = yuv + width * height;
+  for (uint32_t y = 0; y < dst_height; y++) {
+    // region origin is even, a 2x2 block shares one VU sample
+    uint32_t row = top + y * 2;
+    const uint8_t *y0 = yuv + row * width + left;
+    const uint8_t *y1 = y0 + width;
+    const uint8_t *vu = vu_plane + (row >> 1) * width + left;
+    uint8_t *out = dst + y * dst_step;
+    for (uint32_t x = 0; x < dst_width; x++) {
+      int32_t v = static_cast<int32_t>(vu[x * 2]) - 128;
+      int32_t u = static_cast<int32_t>(vu[x * 2 + 1]) - 128;
+      int32_t ruv = kHalf + kCvr * v;
+      int32_t guv = kHalf + kCvg * v + kCug * u;
+      int32_t buv = kHalf + kCub * u;
+      int32_t l00 = Luma(y0[x * 2]);
+      int32_t l01 = Luma(y0[x * 2 + 1]);
+      int32_t l10 = Luma(y1[x * 2]);
+      int32_t l11 = Luma(y1[x * 2 + 1]);
+      // each pixel saturates before the 2x2 mean, as the two-step path does
+      out[x * 3] = static_cast<uint8_t>((Saturate((l00 + ruv) >> kShift)
+          + Saturate((l01 + ruv) >> kShift) + Saturate((l10 + ruv) >> kShift)
+          + Saturate((l11 + ruv) >> kShift) + 2) >> 2);
+      out[x * 3 + 1] = static_cast<uint8_t>((Saturate((l00 + guv) >> kShift)
+          + Saturate((l01 + guv) >> kShift) + Saturate((l10 + guv) >> kShift)
+          + Saturate((l11 + guv) >> kShift) + 2) >> 2);
+      out[x * 3 + 2] = static_cast<uint8_t>((Saturate((l00 + buv) >> kShift)
+          + Saturate((l01 + buv) >> kShift) + Saturate((l10 + buv) >> kShift)
+          + Saturate((l11 + buv) >> kShift) + 2) >> 2);
+    }
+  }
+  return true;
+}
+
+bool Nv21RowsToRgb(const uint8_t *yuv, uint32_t width, uint32_t height,
+                   uint32_t top, uint32_t rows, uint8_t *dst,
+                   uint32_t dst_step) {
+  if (yuv == nullptr || dst == nullptr || (width & 1) != 0
+      || top + rows > height) {
+    return false;
+  }
+  const uint8_t *vu_plane = yuv + width * height;
+  for (uint32_t y = 0; y < rows; y++) {
+    uint32_t row = top + y;
+    const uint8_t *luma = yuv + row * width;
+    const uint8_t *vu = vu_plane + (row >> 1) * width;
+    uint8_t *out = dst + y * dst_step;
+    for (uint32_t x = 0; x < width; x += 2) {
+      int32_t v = static_cast<int32_t>(vu[x]) - 128;
+      int32_t u = static_cast<int32_t>(vu[x + 1]) - 128;
+      int32_t ruv = kHalf + kCvr * v;
+      int32_t guv = kHalf + kCvg * v + kCug * u;
+      int32_t buv = kHalf + kCub * u;
+      int32_t l0 = Luma(luma[x]);
+      int32_t l1 = Luma(luma[x + 1]);
+      out[x * 3] = static_cast<uint8_t>(Saturate((l0 + ruv) >> kShift));
+      out[x * 3 + 1] = static_cast<uint8_t>(Saturate((l0 + guv) >> kShift));
+      out[x * 3 + 2] = static_cast<uint8_t>(Saturate((l0 + buv) >> kShift));
+      out[x * 3 + 3] = static_cast<uint8_t>(Saturate((l1 + ruv) >> kShift));
+      out[x * 3 + 4] = static_cast<uint8_t>(Saturate((l1 + guv) >> kShift));
+      out[x * 3 + 5] = static_cast<uint8_t>(Saturate((l1 + buv) >> kShift));
+    }
+  }
+  return true;
+}
+
+}  // namespace color
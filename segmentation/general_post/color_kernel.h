@@ -0,0 +1,84 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_COLOR_KERNEL_H_
+#define GENERAL_POST_COLOR_KERNEL_H_
+
+#include <stdint.h>
+
+/**
+ * @brief: colour conversion of camera frames, fixed point of OpenCV
+ *         (BT.601 limited range, 20-bit coefficients)
+ */
+namespace color {
+
+/**
+ * @brief: NV21 region to RGB downsampled 2:1 by 2x2 mean, in one pass and
+ *         without intermediate images. Bit-exact with cv::cvtColor
+ *         CV_YUV2RGB_NV21 on the frame, crop, then cv::resize to half size
+ *         (OpenCV takes INTER_LINEAR at exactly 2:1 as area averaging)
+ * @param [in]: yuv: frame, Y plane then interleaved VU plane, stride width
+ * @param [in]: width: frame width
+ * @param [in]: height: frame height
+ * @param [in]: left: region left, even
+ * @param [in]: top: region top, even
+ * @param [out]: dst: RGB output, region is twice its size
+ * @param [in]: dst_width: output width
+ * @param [in]: dst_height: output height
+ * @param [in]: dst_step: bytes per output row
+ * @return: true: success; false: region is outside frame or origin is odd
+ */
+bool Nv21RegionToRgbHalf(const uint8_t *yuv, uint32_t width, uint32_t height,
+                         uint32_t left, uint32_t top, uint8_t *dst,
+                         uint32_t dst_width, uint32_t dst_height,
+                         uint32_t dst_step);
+
+/**
+ * @brief: NV21 rows to RGB at full resolution, bit-exact with cv::cvtColor
+ *         CV_YUV2RGB_NV21; any row range, so frames convert in bands
+ * @param [in]: yuv: frame, Y plane then interleaved VU plane, stride width
+ * @param [in]: width: frame width, even
+ * @param [in]: height: frame height
+ * @param [in]: top: first row
+ * @param [in]: rows: rows to convert
+ * @param [out]: dst: RGB output of first row
+ * @param [in]: dst_step: bytes per output row
+ * @return: true: success; false: rows are outside frame
+ */
+bool Nv21RowsToRgb(const uint8_t *yuv, uint32_t width, uint32_t height,
+                   uint32_t top, uint32_t rows, uint8_t *dst,
+                   uint32_t dst_step);
+
+}  // namespace color
+
+#endif /* GENERAL_POST_COLOR_KERNEL_H_ */
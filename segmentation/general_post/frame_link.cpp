@@ -0,0 +1,293 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "frame_link.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "tool_api.h"
+
+namespace {
+// socket must not raise SIGPIPE or wait
+const int kSendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+
+bool WouldBlock(int error) {
+  return error == EAGAIN || error == EWOULDBLOCK;
+}
+}
+
+FrameLink::FrameLink(const sockaddr_in &address, uint32_t backoff_min_ms,
+                     uint32_t backoff_max_ms)
+    : address_(address),
+      fd_(-1),
+      state_(kIdle),
+      backoff_min_ms_(std::max(backoff_min_ms, 1u)),
+      backoff_max_ms_(std::max(backoff_max_ms, backoff_min_ms_)),
+      backoff_ms_(backoff_min_ms_),
+      retry_us_(0),
+      connect_us_(0),
+      pending_offset_(0),
+      start_us_(SteadyNowUs()),
+      connected_us_(0),
+      connections_(0),
+      frames_sent_(0),
+      frames_busy_(0),
+      frames_offline_(0),
+      partial_writes_(0),
+      bytes_sent_(0) {
+}
+
+FrameLink::~FrameLink() {
+  Close();
+}
+
+bool FrameLink::Connected() {
+  if (state_ == kIdle && SteadyNowUs() >= retry_us_) {
+    Connect();
+  }
+  if (state_ == kConnecting) {
+    struct pollfd event = { fd_, POLLOUT, 0 };
+    if (poll(&event, 1, 0) == 0) {
+      // viewer host may be gone, do not wait longer than a retry period
+      if (SteadyNowUs() - connect_us_ > backoff_max_ms_ * 1000LL) {
+        Disconnect("connect timed out");
+      }
+      return false;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0
+        || error != 0) {
+      Disconnect(strerror(error != 0 ? error : errno));
+      return false;
+    }
+    state_ = kConnected;
+    connect_us_ = SteadyNowUs();
+    backoff_ms_ = backoff_min_ms_;
+    connections_++;
+    INFO_LOG("--post-- viewer connected, connection %lu",
+             (unsigned long) connections_);
+  }
+  return state_ == kConnected;
+}
+
+void FrameLink::Connect() {
+  fd_ = socket(PF_INET, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    Disconnect("socket() failed");
+    return;
+  }
+  int flags = fcntl(fd_, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+    Disconnect("fcntl() failed");
+    return;
+  }
+  connect_us_ = SteadyNowUs();
+  if (connect(fd_, reinterpret_cast<sockaddr *>(&address_),
+              sizeof(address_)) < 0 && errno != EINPROGRESS) {
+    Disconnect(strerror(errno));
+    return;
+  }
+  // done or in progress, Connected() finds out which
+  state_ = kConnecting;
+}
+
+void FrameLink::Disconnect(const char *reason) {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  if (state_ == kConnected) {
+    connected_us_ += SteadyNowUs() - connect_us_;
+    // first retry of a lost connection is quick
+    backoff_ms_ = backoff_min_ms_;
+    INFO_LOG("--post-- viewer disconnected: %s", reason);
+  } else if (state_ == kConnecting) {
+    INFO_LOG("--post-- viewer connect failed: %s, retry in %ums", reason,
+             backoff_ms_);
+  }
+  pending_.clear();
+  pending_offset_ = 0;
+  state_ = kIdle;
+  retry_us_ = SteadyNowUs() + backoff_ms_ * 1000LL;
+  backoff_ms_ = std::min(backoff_ms_ * 2, backoff_max_ms_);
+}
+
+void FrameLink::Close() {
+  if (state_ != kClosed) {
+    Disconnect("closed");
+    state_ = kClosed;
+  }
+}
+
+bool FrameLink::Flush() {
+  while (pending_offset_ < pending_.size()) {
+    ssize_t sent = send(fd_, pending_.data() + pending_offset_,
+                        pending_.size() - pending_offset_, kSendFlags);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (!WouldBlock(errno)) {
+        Disconnect(strerror(errno));
+      }
+      return false;
+    }
+    pending_offset_ += sent;
+    bytes_sent_ += sent;
+  }
+  pending_.clear();
+  pending_offset_ = 0;
+  return true;
+}
+
+bool FrameLink::Send(FrameHeader &header, const struct iovec *parts,
+                     int count) {
+  if (!Connected()) {
+    frames_offline_++;
+    return false;
+  }
+  if (!Flush()) {
+    if (state_ == kConnected) {
+      frames_busy_++;
+    } else {
+      frames_offline_++;
+    }
+    return false;
+  }
+  struct iovec vector[kMaxParts + 1];
+  count = std::min(count, kMaxParts);
+  header.magic = kFrameMagic;
+  header.version = kFrameVersion;
+  header.bytes = 0;
+  for (int index = 0; index < count; index++) {
+    vector[index + 1] = parts[index];
+    header.bytes += parts[index].iov_len;
+  }
+  vector[0].iov_base = &header;
+  vector[0].iov_len = sizeof(header);
+  struct iovec *part = vector;
+  int left = count + 1;
+  while (left > 0) {
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = part;
+    message.msg_iovlen = left;
+    ssize_t sent = sendmsg(fd_, &message, kSendFlags);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent < 0 && !WouldBlock(errno)) {
+      Disconnect(strerror(errno));
+      frames_offline_++;
+      return false;
+    }
+    if (sent < 0) {
+      break;
+    }
+    bytes_sent_ += sent;
+    // skip what went out, the first part left may be partly sent
+    while (left > 0 && (size_t) sent >= part->iov_len) {
+      sent -= part->iov_len;
+      part++;
+      left--;
+    }
+    if (left > 0) {
+      part->iov_base = static_cast<uint8_t *>(part->iov_base) + sent;
+      part->iov_len -= sent;
+    }
+  }
+  if (left > 0) {
+    // caller reuses its buffers, keep a copy of the rest
+    partial_writes_++;
+    for (int index = 0; index < left; index++) {
+      const uint8_t *bytes = static_cast<const uint8_t *>(part[index].iov_base);
+      pending_.insert(pending_.end(), bytes, bytes + part[index].iov_len);
+    }
+  }
+  frames_sent_++;
+  return true;
+}
+
+bool FrameLink::WaitWritable(int timeout_ms) {
+  if (pending_offset_ >= pending_.size()) {
+    return true;
+  }
+  struct pollfd event = { fd_, POLLOUT, 0 };
+  if (poll(&event, 1, timeout_ms) <= 0) {
+    return false;
+  }
+  return Flush();
+}
+
+size_t FrameLink::Receive(void *buffer, size_t size) {
+  if (!Connected()) {
+    return 0;
+  }
+  while (true) {
+    ssize_t received = recv(fd_, buffer, size, MSG_DONTWAIT);
+    if (received > 0) {
+      return received;
+    }
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received == 0 || !WouldBlock(errno)) {
+      Disconnect(received == 0 ? "closed by viewer" : strerror(errno));
+    }
+    return 0;
+  }
+}
+
+std::string FrameLink::ToString() const {
+  int64_t now_us = SteadyNowUs();
+  int64_t connected_us = connected_us_
+      + (state_ == kConnected ? now_us - connect_us_ : 0);
+  double seconds = std::max(now_us - start_us_, (int64_t) 1) / 1e6;
+  std::stringstream sstream;
+  sstream << "connected " << (state_ == kConnected ? 1 : 0)
+          << ", connections " << connections_ << ", frames " << frames_sent_
+          << ", busy drops " << frames_busy_ << ", offline drops "
+          << frames_offline_ << ", partial writes " << partial_writes_
+          << ", bytes " << bytes_sent_ << ", MB/s "
+          << bytes_sent_ / seconds / 1e6 << ", connected "
+          << connected_us * 100.0 / (seconds * 1e6) << "%";
+  return sstream.str();
+}
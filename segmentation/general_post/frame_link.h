@@ -0,0 +1,188 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_FRAME_LINK_H_
+#define GENERAL_POST_FRAME_LINK_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief: header before every frame on the viewer connection, host byte
+ *         order, followed by bytes of payload of the encoding
+ */
+struct FrameHeader {
+  uint32_t magic;         // kFrameMagic
+  uint16_t version;       // kFrameVersion
+  uint16_t encoding;      // FrameEncoding of payload
+  uint32_t frame_id;
+  uint16_t width;         // image, mask or grid width
+  uint16_t height;        // image, mask or grid height
+  uint64_t timestamp_us;  // capture time on host steady clock, 0 if none
+  uint32_t bytes;         // payload bytes
+  uint16_t flags;         // kFrameBgr
+  uint16_t reserved;
+};
+static_assert(sizeof(FrameHeader) == 32, "frame header is not packed");
+
+// "SEGF" in memory order
+const uint32_t kFrameMagic = 0x46474553;
+const uint16_t kFrameVersion = 1;
+
+// image payload is BGR, else RGB
+const uint16_t kFrameBgr = 1;
+
+/**
+ * @brief: payload of a frame; records keep their own header inside
+ */
+enum FrameEncoding {
+  kEncodingImage = 1,      // width * height * 3 pixels
+  kEncodingStripe = 2,     // StripeHeader and its rows
+  kEncodingPolygon = 3,    // PolygonHeader and its points
+  kEncodingFreeSpace = 4,  // FreeSpaceHeader and its columns
+  kEncodingBev = 5         // BevHeader and its cells
+};
+
+/**
+ * @brief: viewer connection sending framed records without blocking the
+ *         caller. A frame the socket does not take whole is kept and
+ *         finished by later calls; a new frame is dropped until then, so
+ *         frames never interleave. A lost connection is retried with
+ *         exponential backoff, frames while it is down are dropped
+ */
+class FrameLink {
+public:
+  // payload parts of one frame, header excluded
+  static const int kMaxParts = 4;
+
+  /**
+   * @brief: constructor, connects on first use
+   * @param [in]: address: viewer address
+   * @param [in]: backoff_min_ms: first retry delay
+   * @param [in]: backoff_max_ms: retry delay limit
+   */
+  FrameLink(const sockaddr_in &address, uint32_t backoff_min_ms,
+            uint32_t backoff_max_ms);
+
+  ~FrameLink();
+
+  /**
+   * @brief: advance connecting, never waits
+   * @return: true when connected
+   */
+  bool Connected();
+
+  /**
+   * @brief: send one frame; magic, version and bytes of header are filled
+   * @param [in]: header: frame header
+   * @param [in]: parts: payload parts, at most kMaxParts
+   * @param [in]: count: payload parts
+   * @return: true: frame sent or in flight; false: dropped
+   */
+  bool Send(FrameHeader &header, const struct iovec *parts, int count);
+
+  /**
+   * @brief: wait for the socket to take the rest of the frame in flight
+   * @param [in]: timeout_ms: longest wait
+   * @return: true when nothing is left, a new frame goes out whole
+   */
+  bool WaitWritable(int timeout_ms);
+
+  /**
+   * @brief: read what the viewer sent, never waits
+   * @return: bytes read, 0 when nothing or not connected
+   */
+  size_t Receive(void *buffer, size_t size);
+
+  /**
+   * @brief: close connection, no retry afterwards
+   */
+  void Close();
+
+  /**
+   * @brief: connections made so far, tells a new viewer session
+   */
+  uint64_t Connections() const {
+    return connections_;
+  }
+
+  std::string ToString() const;
+
+private:
+  enum State {
+    kIdle,        // waiting for retry
+    kConnecting,  // connect in progress
+    kConnected,
+    kClosed
+  };
+
+  void Connect();
+
+  /**
+   * @brief: close socket and plan the next attempt
+   */
+  void Disconnect(const char *reason);
+
+  /**
+   * @brief: write remainder of the frame in flight
+   * @return: true when nothing is left
+   */
+  bool Flush();
+
+  sockaddr_in address_;
+  int fd_;
+  State state_;
+  uint32_t backoff_min_ms_;
+  uint32_t backoff_max_ms_;
+  uint32_t backoff_ms_;
+  int64_t retry_us_;
+  int64_t connect_us_;    // start of connect or of connection
+  std::vector<uint8_t> pending_;
+  size_t pending_offset_;
+
+  // statistics
+  int64_t start_us_;
+  int64_t connected_us_;  // of closed connections
+  uint64_t connections_;
+  uint64_t frames_sent_;
+  uint64_t frames_busy_;  // dropped, previous frame in flight
+  uint64_t frames_offline_;
+  uint64_t partial_writes_;
+  uint64_t bytes_sent_;
+};
+
+#endif /* GENERAL_POST_FRAME_LINK_H_ */
@@ -0,0 +1,302 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "frame_sender.h"
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "tool_api.h"
+
+namespace {
+// posting thread holds no slot
+const uint32_t kNoSlot = UINT32_MAX;
+
+// longest sleep of the sender thread, bounds reaction to viewer requests
+// and reconnects
+const int kIdleWaitMs = 10;
+
+// retry interval of a blocked Post
+const useconds_t kBlockRetryUs = 200;
+
+// link statistics are logged by the sender thread every period
+const int64_t kReportIntervalUs = 10000000;
+
+// longest drain of queued frames on Stop
+const int64_t kStopDrainUs = 2000000;
+}
+
+SlotRing::SlotRing(uint32_t capacity)
+    : capacity_(capacity),
+      slots_(new std::atomic<uint32_t>[capacity]),
+      head_(0),
+      tail_(0) {
+}
+
+bool SlotRing::Push(uint32_t slot) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  if (head - tail_.load(std::memory_order_acquire) >= capacity_) {
+    return false;
+  }
+  slots_[head % capacity_].store(slot, std::memory_order_relaxed);
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool SlotRing::Pop(uint32_t &slot) {
+  uint64_t tail = tail_.load(std::memory_order_acquire);
+  while (tail != head_.load(std::memory_order_acquire)) {
+    // entry may be rewritten once another pop wins, then the swap fails
+    uint32_t value = slots_[tail % capacity_].load(std::memory_order_relaxed);
+    if (tail_.compare_exchange_weak(tail, tail + 1,
+                                    std::memory_order_acq_rel,
+                                    std::memory_order_acquire)) {
+      slot = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+FrameSender::FrameSender(const sockaddr_in &address, uint32_t backoff_min_ms,
+                         uint32_t backoff_max_ms, uint32_t depth,
+                         DropPolicy policy, bool subscribed)
+    : link_(address, backoff_min_ms, backoff_max_ms),
+      policy_(policy),
+      default_subscribed_(subscribed),
+      connection_(0),
+      // queued ones, one being filled and one being sent
+      slots_(std::max(depth, 1u) + 2),
+      queued_(std::max(depth, 1u)),
+      free_(slots_.size()),
+      filling_(kNoSlot),
+      started_(false),
+      running_(false),
+      connected_(false),
+      subscribed_(false),
+      frames_posted_(0),
+      frames_sent_(0),
+      dropped_oldest_(0),
+      dropped_newest_(0),
+      dropped_link_(0),
+      depth_total_(0),
+      blocked_us_(0),
+      latency_us_total_(0),
+      latency_us_max_(0) {
+  for (uint32_t slot = 0; slot < slots_.size(); slot++) {
+    free_.Push(slot);
+  }
+  sem_init(&posted_, 0, 0);
+}
+
+FrameSender::~FrameSender() {
+  Stop();
+  sem_destroy(&posted_);
+}
+
+bool FrameSender::Start() {
+  if (started_) {
+    return true;
+  }
+  running_.store(true);
+  try {
+    thread_ = std::thread(&FrameSender::Run, this);
+  } catch (...) {
+    running_.store(false);
+    return false;
+  }
+  started_ = true;
+  return true;
+}
+
+void FrameSender::Stop() {
+  if (!started_) {
+    return;
+  }
+  running_.store(false, std::memory_order_release);
+  sem_post(&posted_);
+  thread_.join();
+  started_ = false;
+}
+
+bool FrameSender::Post(const FrameHeader &header, const struct iovec *parts,
+                       int count) {
+  if (filling_ == kNoSlot && !free_.Pop(filling_)) {
+    // every slot is queued or sending, only when depth is exceeded
+    dropped_newest_++;
+    return false;
+  }
+  Slot &slot = slots_[filling_];
+  slot.header = header;
+  slot.payload.clear();
+  for (int index = 0; index < count; index++) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(parts[index].iov_base);
+    slot.payload.insert(slot.payload.end(), bytes,
+                        bytes + parts[index].iov_len);
+  }
+  slot.posted_us = SteadyNowUs();
+  frames_posted_++;
+  depth_total_ += queued_.Size();
+  while (!queued_.Push(filling_)) {
+    if (policy_ == kDropNewest) {
+      // slot is kept for the next frame
+      dropped_newest_++;
+      return false;
+    }
+    uint32_t oldest = kNoSlot;
+    if (policy_ == kDropOldest) {
+      // sender may take it first, then there is room
+      if (queued_.Pop(oldest)) {
+        dropped_oldest_++;
+        // replaces the oldest, which was posted already
+        queued_.Push(filling_);
+        filling_ = oldest;
+        return true;
+      }
+      continue;
+    }
+    if (!running_.load(std::memory_order_acquire)) {
+      dropped_newest_++;
+      return false;
+    }
+    int64_t begin_us = SteadyNowUs();
+    usleep(kBlockRetryUs);
+    blocked_us_ += SteadyNowUs() - begin_us;
+  }
+  filling_ = kNoSlot;
+  sem_post(&posted_);
+  return true;
+}
+
+void FrameSender::WaitPosted(int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += timeout_ms * 1000000L;
+  deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+  deadline.tv_nsec %= 1000000000L;
+  while (sem_timedwait(&posted_, &deadline) < 0 && errno == EINTR) {
+  }
+}
+
+void FrameSender::ReadRequests() {
+  uint8_t requests[16];
+  size_t size = 0;
+  do {
+    size = link_.Receive(requests, sizeof(requests));
+    if (link_.Connections() != connection_) {
+      // subscription of the previous viewer does not carry over
+      connection_ = link_.Connections();
+      subscribed_.store(default_subscribed_, std::memory_order_relaxed);
+    }
+    for (size_t index = 0; index < size; index++) {
+      if (requests[index] == 'O') {
+        subscribed_.store(true, std::memory_order_relaxed);
+      } else if (requests[index] == 'o') {
+        subscribed_.store(false, std::memory_order_relaxed);
+      }
+    }
+  } while (size > 0);
+  connected_.store(link_.Connected(), std::memory_order_relaxed);
+}
+
+void FrameSender::Run() {
+  int64_t report_us = SteadyNowUs() + kReportIntervalUs;
+  int64_t stop_us = 0;
+  while (true) {
+    bool running = running_.load(std::memory_order_acquire);
+    if (!running && stop_us == 0) {
+      stop_us = SteadyNowUs() + kStopDrainUs;
+    }
+    ReadRequests();
+    if (SteadyNowUs() >= report_us) {
+      INFO_LOG("--post-- link: %s", link_.ToString().c_str());
+      report_us += kReportIntervalUs;
+    }
+    // frames wait in the queue, where the drop policy applies, until the
+    // link has taken the previous one whole
+    if (!link_.WaitWritable(kIdleWaitMs)) {
+      if (!running && SteadyNowUs() >= stop_us) {
+        break;
+      }
+      continue;
+    }
+    uint32_t index = kNoSlot;
+    if (!queued_.Pop(index)) {
+      if (!running) {
+        break;
+      }
+      WaitPosted(kIdleWaitMs);
+      continue;
+    }
+    // one post per queued frame, a frame popped before its post leaves
+    // one extra wakeup
+    sem_trywait(&posted_);
+    Slot &slot = slots_[index];
+    struct iovec part = { slot.payload.data(), slot.payload.size() };
+    if (link_.Send(slot.header, &part, 1)) {
+      frames_sent_++;
+    } else {
+      dropped_link_++;
+    }
+    uint64_t latency_us = SteadyNowUs() - slot.posted_us;
+    latency_us_total_ += latency_us;
+    if (latency_us > latency_us_max_.load(std::memory_order_relaxed)) {
+      latency_us_max_.store(latency_us, std::memory_order_relaxed);
+    }
+    free_.Push(index);
+  }
+  link_.Close();
+  connected_.store(false, std::memory_order_relaxed);
+  INFO_LOG("--post-- link: %s", link_.ToString().c_str());
+}
+
+std::string FrameSender::ToString() const {
+  uint64_t posted = frames_posted_.load();
+  uint64_t handled = frames_sent_.load() + dropped_link_.load();
+  std::stringstream sstream;
+  sstream << "posted " << posted << ", sent " << frames_sent_.load()
+          << ", dropped oldest " << dropped_oldest_.load()
+          << ", dropped newest " << dropped_newest_.load()
+          << ", dropped offline " << dropped_link_.load() << ", depth "
+          << queued_.Size() << "/" << queued_.Capacity() << ", mean depth "
+          << (posted > 0 ? depth_total_.load() * 1.0 / posted : 0.0)
+          << ", blocked " << blocked_us_.load() / 1000 << "ms"
+          << ", send latency mean "
+          << (handled > 0 ? latency_us_total_.load() / 1000.0 / handled : 0.0)
+          << "ms max " << latency_us_max_.load() / 1000.0 << "ms";
+  return sstream.str();
+}
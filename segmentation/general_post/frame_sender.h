@@ -0,0 +1,192 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_FRAME_SENDER_H_
+#define GENERAL_POST_FRAME_SENDER_H_
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_link.h"
+
+/**
+ * @brief: what Post does when the queue is full
+ */
+enum DropPolicy {
+  kDropOldest = 0,  // replace the oldest queued frame, viewer sees latest
+  kDropNewest = 1,  // keep queued frames, discard the posted one
+  kDropBlock = 2    // wait for the sender, slows the pipeline to the link
+};
+
+/**
+ * @brief: bounded ring of slot indices. One thread pushes; pops are a
+ *         compare-and-swap on the tail, so the pushing thread may take the
+ *         oldest entry back while another thread pops
+ */
+class SlotRing {
+public:
+  explicit SlotRing(uint32_t capacity);
+
+  bool Push(uint32_t slot);
+
+  bool Pop(uint32_t &slot);
+
+  uint32_t Size() const {
+    return static_cast<uint32_t>(head_.load(std::memory_order_acquire)
+        - tail_.load(std::memory_order_acquire));
+  }
+
+  uint32_t Capacity() const {
+    return capacity_;
+  }
+
+private:
+  uint32_t capacity_;
+  std::unique_ptr<std::atomic<uint32_t>[]> slots_;
+  // positions only grow, a stale tail never compares equal again
+  alignas(64) std::atomic<uint64_t> head_;
+  alignas(64) std::atomic<uint64_t> tail_;
+};
+
+/**
+ * @brief: sends frames to the viewer on its own thread so a slow link
+ *         never holds the engine thread. Post copies the frame into a
+ *         preallocated slot and queues it; the sender thread waits for
+ *         the link to take each frame whole. Viewer requests are read on
+ *         the sender thread too: 'O' subscribes to the overlay and 'o'
+ *         stops it, every connection starts from the configured default
+ */
+class FrameSender {
+public:
+  /**
+   * @brief: constructor
+   * @param [in]: address: viewer address
+   * @param [in]: backoff_min_ms: first reconnect delay
+   * @param [in]: backoff_max_ms: reconnect delay limit
+   * @param [in]: depth: queued frames, at least 1
+   * @param [in]: policy: what to drop when the queue is full
+   * @param [in]: subscribed: overlay subscription of a new connection
+   */
+  FrameSender(const sockaddr_in &address, uint32_t backoff_min_ms,
+              uint32_t backoff_max_ms, uint32_t depth, DropPolicy policy,
+              bool subscribed);
+
+  ~FrameSender();
+
+  /**
+   * @brief: start the sender thread
+   * @return: true: success; false: failed
+   */
+  bool Start();
+
+  /**
+   * @brief: send what is queued while the link takes it, then close
+   */
+  void Stop();
+
+  /**
+   * @brief: queue one frame, called from one thread only; magic, version
+   *         and bytes of header are filled by the link
+   * @param [in]: header: frame header
+   * @param [in]: parts: payload parts, copied before returning
+   * @param [in]: count: payload parts
+   * @return: true: queued; false: dropped
+   */
+  bool Post(const FrameHeader &header, const struct iovec *parts,
+            int count);
+
+  bool Connected() const {
+    return connected_.load(std::memory_order_relaxed);
+  }
+
+  bool Subscribed() const {
+    return subscribed_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief: queue statistics, safe from the posting thread
+   */
+  std::string ToString() const;
+
+private:
+  struct Slot {
+    FrameHeader header;
+    std::vector<uint8_t> payload;
+    int64_t posted_us;
+  };
+
+  void Run();
+
+  /**
+   * @brief: apply viewer requests, tracks connection changes
+   */
+  void ReadRequests();
+
+  /**
+   * @brief: wait for a posted frame, or until timeout_ms passed
+   */
+  void WaitPosted(int timeout_ms);
+
+  FrameLink link_;
+  DropPolicy policy_;
+  bool default_subscribed_;
+  uint64_t connection_;         // sender thread only
+  std::vector<Slot> slots_;
+  SlotRing queued_;             // posted, oldest first
+  SlotRing free_;               // sent, back to the posting thread
+  uint32_t filling_;            // posting thread's slot, kNoSlot if none
+  sem_t posted_;
+  bool started_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<bool> connected_;
+  std::atomic<bool> subscribed_;
+
+  // statistics
+  std::atomic<uint64_t> frames_posted_;
+  std::atomic<uint64_t> frames_sent_;
+  std::atomic<uint64_t> dropped_oldest_;
+  std::atomic<uint64_t> dropped_newest_;
+  std::atomic<uint64_t> dropped_link_;  // link was down
+  std::atomic<uint64_t> depth_total_;   // queue depth seen by Post
+  std::atomic<uint64_t> blocked_us_;
+  std::atomic<uint64_t> latency_us_total_;  // Post to link
+  std::atomic<uint64_t> latency_us_max_;
+};
+
+#endif /* GENERAL_POST_FRAME_SENDER_H_ */
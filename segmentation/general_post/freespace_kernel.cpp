@@ -0,0 +1,143 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "freespace_kernel.h"
+
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FREESPACE_KERNEL_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FREESPACE_KERNEL_SSE2 1
+#endif
+
+namespace freespace {
+
+void ScanReset(uint16_t *boundary, uint8_t *confidence, uint32_t width,
+               uint32_t height) {
+  for (uint32_t x = 0; x < width; x++) {
+    boundary[x] = static_cast<uint16_t>(height);
+  }
+  memset(confidence, 255, width);
+}
+
+bool ScanRowReference(const uint8_t *road, const uint8_t *prob, uint32_t row,
+                      uint8_t level, uint16_t *boundary, uint8_t *confidence,
+                      uint32_t width) {
+  bool open = false;
+  for (uint32_t x = 0; x < width; x++) {
+    // column is open while its run reaches the row below
+    if (boundary[x] == row + 1 && road[x] >= level) {
+      boundary[x] = static_cast<uint16_t>(row);
+      if (prob[x] < confidence[x]) {
+        confidence[x] = prob[x];
+      }
+      open = true;
+    }
+  }
+  return open;
+}
+
+bool ScanRow(const uint8_t *road, const uint8_t *prob, uint32_t row,
+             uint8_t level, uint16_t *boundary, uint8_t *confidence,
+             uint32_t width) {
+  uint32_t x = 0;
+  bool open = false;
+#if defined(FREESPACE_KERNEL_NEON)
+  uint16x8_t below = vdupq_n_u16(static_cast<uint16_t>(row + 1));
+  uint16x8_t current = vdupq_n_u16(static_cast<uint16_t>(row));
+  uint8x8_t level_v = vdup_n_u8(level);
+  uint16x8_t any = vdupq_n_u16(0);
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t bound = vld1q_u16(boundary + x);
+    uint8x8_t is_road = vcge_u8(vld1_u8(road + x), level_v);
+    uint16x8_t extend = vandq_u16(vceqq_u16(bound, below),
+                                  vmovl_u8(is_road));
+    // 0xFF per open column widened, make it a full lane mask
+    extend = vtstq_u16(extend, extend);
+    vst1q_u16(boundary + x, vbslq_u16(extend, current, bound));
+    uint8x8_t conf = vld1_u8(confidence + x);
+    uint8x8_t lowest = vmin_u8(conf, vld1_u8(prob + x));
+    vst1_u8(confidence + x, vbsl_u8(vmovn_u16(extend), lowest, conf));
+    any = vorrq_u16(any, extend);
+  }
+  uint16x4_t any_half = vorr_u16(vget_low_u16(any), vget_high_u16(any));
+  open = vget_lane_u64(vreinterpret_u64_u16(any_half), 0) != 0;
+#elif defined(FREESPACE_KERNEL_SSE2)
+  __m128i below = _mm_set1_epi16(static_cast<int16_t>(row + 1));
+  __m128i current = _mm_set1_epi16(static_cast<int16_t>(row));
+  // levels are below 256, signed compares are safe
+  __m128i level_v = _mm_set1_epi16(static_cast<int16_t>(level) - 1);
+  __m128i zero = _mm_setzero_si128();
+  __m128i any = zero;
+  for (; x + 8 <= width; x += 8) {
+    __m128i bound = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+        boundary + x));
+    __m128i road_v = _mm_unpacklo_epi8(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(road + x)), zero);
+    __m128i extend = _mm_and_si128(_mm_cmpeq_epi16(bound, below),
+                                   _mm_cmpgt_epi16(road_v, level_v));
+    bound = _mm_or_si128(_mm_and_si128(extend, current),
+                         _mm_andnot_si128(extend, bound));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(boundary + x), bound);
+    __m128i conf = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(
+        confidence + x));
+    __m128i lowest = _mm_min_epu8(conf, _mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(prob + x)));
+    __m128i extend8 = _mm_packs_epi16(extend, extend);
+    conf = _mm_or_si128(_mm_and_si128(extend8, lowest),
+                        _mm_andnot_si128(extend8, conf));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(confidence + x), conf);
+    any = _mm_or_si128(any, extend);
+  }
+  open = _mm_movemask_epi8(any) != 0;
+#endif
+  if (x < width) {
+    open = ScanRowReference(road + x, prob + x, row, level, boundary + x,
+                            confidence + x, width - x) || open;
+  }
+  return open;
+}
+
+void ScanFinish(const uint16_t *boundary, uint8_t *confidence,
+                uint32_t width, uint32_t height) {
+  for (uint32_t x = 0; x < width; x++) {
+    if (boundary[x] >= height) {
+      confidence[x] = 0;
+    }
+  }
+}
+
+}  // namespace freespace
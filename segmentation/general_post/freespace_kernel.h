@@ -0,0 +1,89 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_FREESPACE_KERNEL_H_
+#define GENERAL_POST_FREESPACE_KERNEL_H_
+
+#include <stdint.h>
+
+/**
+ * @brief: column free space of the road mask. Rows are scanned bottom-up,
+ *         each column keeps the top row of the road run starting at the
+ *         bottom row, and the lowest probability seen along it. SIMD
+ *         versions (NEON, SSE2) update 8 columns at once and are
+ *         bit-exact with the scalar loop
+ */
+namespace freespace {
+
+/**
+ * @brief: start a scan, no column has free space yet
+ * @param [out]: boundary: height per column
+ * @param [out]: confidence: 255 per column
+ * @param [in]: width: columns
+ * @param [in]: height: rows
+ */
+void ScanReset(uint16_t *boundary, uint8_t *confidence, uint32_t width,
+               uint32_t height);
+
+/**
+ * @brief: extend the scan by the row above the last one; rows are given
+ *         from height - 1 down to 0
+ * @param [in]: road: 8-bit road levels of row, road at level or above
+ * @param [in]: prob: 8-bit probability of row for confidence, may be road
+ * @param [in]: row: row index
+ * @param [in]: level: road level
+ * @param [in/out]: boundary: top row of free run, height if none
+ * @param [in/out]: confidence: lowest probability along free run
+ * @param [in]: width: columns
+ * @return: true: a column is still open; false: rows above change nothing
+ */
+bool ScanRow(const uint8_t *road, const uint8_t *prob, uint32_t row,
+             uint8_t level, uint16_t *boundary, uint8_t *confidence,
+             uint32_t width);
+
+/**
+ * @brief: end a scan, confidence of columns without free space is 0
+ */
+void ScanFinish(const uint16_t *boundary, uint8_t *confidence,
+                uint32_t width, uint32_t height);
+
+/**
+ * @brief: scalar reference of ScanRow
+ */
+bool ScanRowReference(const uint8_t *road, const uint8_t *prob, uint32_t row,
+                      uint8_t level, uint16_t *boundary, uint8_t *confidence,
+                      uint32_t width);
+
+}  // namespace freespace
+
+#endif /* GENERAL_POST_FREESPACE_KERNEL_H_ */
@@ -36,13 +36,19 @@
 #include <unistd.h>
 #include <algorithm>
 #include <cstdlib>
-#include <fstream>
-#include <sstream>
+#include <cstring>
 #include <vector>
 
 #include "hiaiengine/log.h"
+#include "bev_kernel.h"
+#include "class_kernel.h"
+#include "color_kernel.h"
+#include "freespace_kernel.h"
+#include "mask_stabilizer.h"
 #include "opencv2/opencv.hpp"
+#include "overlay_kernel.h"
 #include "tool_api.h"
+#include "worker_pool.h"
 
 using hiai::Engine;
 using namespace std;
@@ -61,10 +67,82 @@ namespace {
   // output image prefix
   const string kOutputFilePrefix = "out_";
 
-  // output image tensor shape  623*188
-  const static std::vector<uint32_t> kDimImageOutput = {117124, 2};
+  // default output tensor shape 188*623*2, HWC, of road overlay; results
+  // carry the shape of the model, class overlay takes any channels and
+  // NCHW too
+  typedef StaticShape<188, 623, 2> OutputShape;
+
+  // default output image width and height
+  const int32_t kDefaultOutputWidth = OutputShape::Dim(1);
+  const int32_t kDefaultOutputHeight = OutputShape::Dim(0);
+
+  // magic of stripe header, "STRP" in memory order
+  const uint32_t kStripeMagic = 0x50525453;
+
+  // magic of polygon record, "POLY" in memory order
+  const uint32_t kPolygonMagic = 0x594C4F50;
+
+  // magic of free space record, "FREE" in memory order
+  const uint32_t kFreeSpaceMagic = 0x45455246;
+
+  // magic of bird's-eye-view record, "BEVG" in memory order
+  const uint32_t kBevMagic = 0x47564542;
+
+  // default bird's-eye-view grid size
+  const uint32_t kBevWidth = 200;
+  const uint32_t kBevHeight = 200;
+
+  // default road probability of polygon and free space
+  const float kRoadThreshold = 0.5f;
+
+  // level of stable mask, 0 or 255
+  const uint8_t kStableRoadLevel = 255;
+
+  // default polygon tolerance in output pixels
+  const double kPolygonEpsilon = 2.0;
+
+  // default delays of viewer reconnects, doubled per failed attempt
+  const uint32_t kReconnectMinMs = 100;
+  const uint32_t kReconnectMaxMs = 5000;
+
+  // default frames queued to the sender thread
+  const uint32_t kSendQueue = 2;
+
+  // default camera frame size
+  const int32_t kCameraWidth = 1280;
+  const int32_t kCameraHeight = 720;
+
+  // road region of camera frame, twice the output size
+  const uint32_t kRoiLeft = 0;
+  const uint32_t kRoiTop = 176;
+
+  // channels of output image tensor of road overlay
+  const int32_t kOutputChannels = OutputShape::Dim(2);
+
+  // default class palette: background undrawn, then magenta, blue, green,
+  // yellow, cyan, red
+  const string kDefaultPalette =
+      "-;255,0,255;0,0,255;0,255,0;255,255,0;0,255,255;255,0,0";
 
   const string kFileSperator = "/";
+
+  // default road mask stabilizer: weight of new frame, off and on levels
+  const float kStabilizeAlpha = 0.3f;
+  const float kStabilizeLow = 0.4f;
+  const float kStabilizeHigh = 0.6f;
+
+  // probability in [0, 1] to 8-bit level
+  uint8_t ProbabilityLevel(float prob) {
+    return static_cast<uint8_t>(min(max(prob, 0.0f), 1.0f) * 255.0f + 0.5f);
+  }
+
+  // start of a scratch area behind bytes, cache line aligned
+  uint32_t ScratchOffset(uint32_t bytes) {
+    return (bytes + 63) & ~63u;
+  }
+
+  // print post statistics every N frames
+  const uint64_t kLatencyReportInterval = 100;
 }
 
 // register custom data type
@@ -73,7 +151,45 @@ HIAI_REGISTER_DATA_TYPE("EngineTrans", EngineTrans);
 HIAI_StatusT GeneralPost::Init(
   const hiai::AIConfig &config,
   const vector<hiai::AIModelDescription> &model_desc) {
-  addrLen = sizeof(struct sockaddr_in);
+  post_frames_ = 0;
+  latency_frames_ = 0;
+  latency_total_ms_ = 0.0;
+  uint32_t post_threads = 1;
+  frame_id_ = 0;
+  stripe_rows_ = 0;
+  output_format_ = kOutputOverlay;
+  road_threshold_ = kRoadThreshold;
+  mask_stats_ = false;
+  mask_stats_frames_ = 0;
+  mask_area_total_ = 0.0;
+  mask_iou_total_ = 0.0;
+  freespace_confidence_ = false;
+  bev_width_ = kBevWidth;
+  bev_height_ = kBevHeight;
+  string bev_homography;
+  polygon_epsilon_ = kPolygonEpsilon;
+  overlay_on_demand_ = false;
+  timestamp_us_ = 0;
+  uint32_t reconnect_min_ms = kReconnectMinMs;
+  uint32_t reconnect_max_ms = kReconnectMaxMs;
+  uint32_t send_queue = kSendQueue;
+  DropPolicy send_drop = kDropOldest;
+  overlay_rendered_ = 0;
+  overlay_skipped_ = 0;
+  full_overlay_ = false;
+  class_overlay_ = false;
+  planar_output_ = false;
+  channels_ = kOutputChannels;
+  string palette = kDefaultPalette;
+  bool stabilize = false;
+  float stabilize_alpha = kStabilizeAlpha;
+  float stabilize_low = kStabilizeLow;
+  float stabilize_high = kStabilizeHigh;
+  camera_width_ = kCameraWidth;
+  camera_height_ = kCameraHeight;
+  int32_t output_width = kDefaultOutputWidth;
+  int32_t output_height = kDefaultOutputHeight;
+  memset(&serverAddr, 0, sizeof(serverAddr));
   serverAddr.sin_family = PF_INET;
 
   for (int index = 0; index < config.items_size(); ++index) {
@@ -88,19 +204,159 @@ HIAI_StatusT GeneralPost::Init(
       int serverPort = atoi(value.data());
       serverAddr.sin_port = htons(serverPort);
       cout << "--post-- serverPort: " << serverPort << endl;
+    } else if (name == "camera_width") {
+      camera_width_ = atoi(value.data());
+    } else if (name == "camera_height") {
+      camera_height_ = atoi(value.data());
+    } else if (name == "output_width") {
+      output_width = atoi(value.data());
+    } else if (name == "output_height") {
+      output_height = atoi(value.data());
+    } else if (name == "overlay_output") {
+      // full: overlay on whole camera frame, crop: road region at output size
+      full_overlay_ = (value == "full");
+      INFO_LOG("--post-- overlay output: %s", value.c_str());
+    } else if (name == "overlay_on_demand") {
+      overlay_on_demand_ = (atoi(value.data()) != 0);
+    } else if (name == "reconnect_min_ms") {
+      reconnect_min_ms = atoi(value.data());
+    } else if (name == "reconnect_max_ms") {
+      reconnect_max_ms = atoi(value.data());
+    } else if (name == "send_queue") {
+      send_queue = max(atoi(value.data()), 1);
+    } else if (name == "send_drop") {
+      // oldest: viewer sees the latest frames, newest: keeps queued ones,
+      // block: pipeline waits for the viewer
+      if (value == "newest") {
+        send_drop = kDropNewest;
+      } else if (value == "block") {
+        send_drop = kDropBlock;
+      } else {
+        send_drop = kDropOldest;
+      }
+    } else if (name == "overlay_mode") {
+      // road: blend probability of channel 0, class: argmax and palette
+      class_overlay_ = (value == "class");
+      INFO_LOG("--post-- overlay mode: %s", value.c_str());
+    } else if (name == "output_layout") {
+      planar_output_ = (value == "nchw");
+    } else if (name == "palette") {
+      if (!value.empty()) {
+        palette = value;
+      }
+    } else if (name == "output_format") {
+      // overlay: image, polygon: outline of largest road region,
+      // freespace: boundary per column, bev: top-down grid
+      if (value == "polygon") {
+        output_format_ = kOutputPolygon;
+      } else if (value == "freespace") {
+        output_format_ = kOutputFreeSpace;
+      } else if (value == "bev") {
+        output_format_ = kOutputBev;
+      } else {
+        output_format_ = kOutputOverlay;
+      }
+      INFO_LOG("--post-- output format: %s", value.c_str());
+    } else if (name == "road_threshold") {
+      road_threshold_ = atof(value.data());
+    } else if (name == "mask_stats") {
+      mask_stats_ = (atoi(value.data()) != 0);
+    } else if (name == "freespace_confidence") {
+      freespace_confidence_ = (atoi(value.data()) != 0);
+    } else if (name == "polygon_epsilon") {
+      polygon_epsilon_ = atof(value.data());
+    } else if (name == "bev_homography") {
+      bev_homography = value;
+    } else if (name == "bev_width") {
+      bev_width_ = atoi(value.data());
+    } else if (name == "bev_height") {
+      bev_height_ = atoi(value.data());
+    } else if (name == "stabilize") {
+      stabilize = (atoi(value.data()) != 0);
+    } else if (name == "stabilize_alpha") {
+      stabilize_alpha = atof(value.data());
+    } else if (name == "stabilize_low") {
+      stabilize_low = atof(value.data());
+    } else if (name == "stabilize_high") {
+      stabilize_high = atof(value.data());
+    } else if (name == "stripe_rows") {
+      stripe_rows_ = atoi(value.data());
+      INFO_LOG("--post-- stripe rows: %u", stripe_rows_);
+    } else if (name == "post_threads") {
+      // 0: one per core, more than the cores only add switching
+      int32_t threads = atoi(value.data());
+      uint32_t cores = max(thread::hardware_concurrency(), 1u);
+      if (threads < 0) {
+        ERROR_LOG("Invalid post threads %s.", value.c_str());
+        return HIAI_ERROR;
+      }
+      post_threads = (threads == 0) ? cores
+          : min(static_cast<uint32_t>(threads), cores);
     } else {
       HIAI_ENGINE_LOG("unused config name: %s", name.c_str());
     }
   }
-  if ((sokt = socket(PF_INET, SOCK_STREAM, 0)) < 0) {
-    cout << "--post-- socket() failed" << endl;
+  if (!classmap::ParsePalette(palette, false, palette_rgb_)
+      || !classmap::ParsePalette(palette, true, palette_bgr_)) {
+    ERROR_LOG("Invalid palette %s.", palette.c_str());
+    return HIAI_ERROR;
+  }
+  road_level_ = ProbabilityLevel(road_threshold_);
+  if (output_format_ == kOutputBev
+      && (!bev::ParseHomography(bev_homography, bev_matrix_)
+          || bev_width_ == 0 || bev_height_ == 0 || bev_width_ > UINT16_MAX
+          || bev_height_ > UINT16_MAX)) {
+    ERROR_LOG("Invalid bev homography %s or grid %ux%u.",
+              bev_homography.c_str(), bev_width_, bev_height_);
+    return HIAI_ERROR;
+  }
+  stabilizer_.reset();
+  if (stabilize && !class_overlay_) {
+    if (stabilize_alpha <= 0.0f || stabilize_alpha > 1.0f
+        || stabilize_low > stabilize_high) {
+      ERROR_LOG("Invalid stabilizer alpha %f, low %f, high %f.",
+                stabilize_alpha, stabilize_low, stabilize_high);
+      return HIAI_ERROR;
+    }
+    stabilizer_.reset(new (nothrow) MaskStabilizer(
+        stabilize_alpha, ProbabilityLevel(stabilize_low),
+        ProbabilityLevel(stabilize_high)));
+    if (stabilizer_ == nullptr) {
+      ERROR_LOG("Failed to create mask stabilizer.");
+      return HIAI_ERROR;
+    }
+    INFO_LOG("--post-- stabilizer: %s", stabilizer_->ToString().c_str());
+  } else if (stabilize) {
+    INFO_LOG("--post-- stabilizer applies to road overlay only, disabled");
+  }
+  try {
+    pool_.reset(new WorkerPool(post_threads));
+  } catch (const std::exception &e) {
+    ERROR_LOG("Worker pool: %s", e.what());
+    pool_.reset();
+  }
+  if (pool_ == nullptr) {
+    ERROR_LOG("Failed to create post worker pool.");
+    return HIAI_ERROR;
+  }
+  INFO_LOG("--post-- post threads: %u", pool_->Threads());
+  // configured shape until results carry the model's
+  output_width_ = 0;
+  output_height_ = 0;
+  if (!Reshape(output_width, output_height)) {
     return HIAI_ERROR;
   }
-  if (connect(sokt, (sockaddr*)&serverAddr, addrLen) < 0) {
-    cout << "--post-- connect() failed!" << endl;
-    cout << "--post-- close socket" << endl;
-    close(sokt);
+  // connects in the background, frames are dropped until it is up
+  sender_.reset(new (nothrow) FrameSender(serverAddr, reconnect_min_ms,
+                                          reconnect_max_ms, send_queue,
+                                          send_drop, !overlay_on_demand_));
+  if (sender_ == nullptr || !sender_->Start()) {
+    ERROR_LOG("Failed to start viewer sender.");
+    return HIAI_ERROR;
   }
+  INFO_LOG("--post-- send queue %u, drop %s", send_queue,
+           send_drop == kDropBlock ? "block"
+           : (send_drop == kDropNewest ? "newest" : "oldest"));
   return HIAI_OK;
 }
 
@@ -127,111 +383,605 @@ bool GeneralPost::SendSentinel() {
   return true;
 }
 
-HIAI_StatusT GeneralPost::ModelPostProcessCap(const shared_ptr<EngineTrans> &result) {
+bool GeneralPost::Reshape(int32_t width, int32_t height) {
+  if (width == output_width_ && height == output_height_) {
+    return true;
+  }
+  if (width <= 0 || height <= 0 || width > UINT16_MAX
+      || height > UINT16_MAX) {
+    ERROR_LOG("Invalid output shape %dx%d.", width, height);
+    return false;
+  }
+  // shape is kept only once every buffer fits it
+  output_width_ = 0;
+  output_height_ = 0;
+  if (!workspace_.Reserve(camera_width_, camera_height_, width, height,
+                          pool_->Threads())) {
+    ERROR_LOG("Failed to allocate post workspace.");
+    return false;
+  }
+  road_mask_.Reset(width, height);
+  previous_road_mask_.Reset(width, height);
+  mask_stats_frames_ = 0;
+  mask_area_total_ = 0.0;
+  mask_iou_total_ = 0.0;
+  if (stabilizer_ != nullptr) {
+    stabilizer_->Reset(width, height);
+  }
+  if (output_format_ == kOutputBev) {
+    // projection of every cell resolved once, frames only gather
+    if (!bev::BuildTable(bev_matrix_, width, height, bev_width_, bev_height_,
+                         bev_table_)) {
+      ERROR_LOG("Output shape %dx%d too large for bev table.", width,
+                height);
+      return false;
+    }
+    bev_mask_.assign(bev::PaddedStep(width) * (height + 2), 0);
+    INFO_LOG("--post-- bev grid %ux%u, table bytes %u", bev_width_,
+             bev_height_, (uint32_t) (bev_table_.size() * sizeof(uint32_t)));
+  }
+  output_width_ = width;
+  output_height_ = height;
+  INFO_LOG("--post-- output shape %dx%d, workspace: %s", width, height,
+           workspace_.ToString().c_str());
+  return true;
+}
 
-  vector<Output> outputs = result->inference_res;
-  
+bool GeneralPost::ArrangeOutput(const shared_ptr<EngineTrans> &result,
+                                TensorView<const float> &output) {
+  const vector<Output> &outputs = result->inference_res;
   if (outputs.size() != kOutputTensorSize) {
     ERROR_LOG("Detection output size does not match.");
-    return HIAI_ERROR;
+    return false;
+  }
+
+  // mask size follows the model picked by inference engine, channels
+  // follow the model; older senders only give the model input size
+  int32_t mask_width = result->output_dims.width;
+  int32_t mask_height = result->output_dims.height;
+  if (mask_width == 0 || mask_height == 0) {
+    mask_width = result->console_params.model_width;
+    mask_height = result->console_params.model_height;
+  }
+  int32_t plane_size = mask_width * mask_height * sizeof(float);
+  if (mask_width <= 0 || mask_height <= 0 || outputs[0].size <= 0
+      || outputs[0].size % plane_size != 0) {
+    ERROR_LOG("Output size %d does not match model %dx%d.", outputs[0].size,
+              mask_width, mask_height);
+    return false;
+  }
+  uint32_t channels = outputs[0].size / plane_size;
+  if (class_overlay_ ? (channels < 2 || channels > classmap::kMaxClasses)
+      : channels != (uint32_t) kOutputChannels) {
+    ERROR_LOG("Unsupported output channels %u.", channels);
+    return false;
+  }
+  if (class_overlay_) {
+    workspace_.ReserveScratch(classmap::ScratchSize(channels, output_width_));
   }
-  // cout << "--post-- start get outputs" << endl;
+  channels_ = channels;
+  int32_t mask_size = outputs[0].size;
   float *img_output = reinterpret_cast<float *>(outputs[0].data.get());
-  // cout << "--post-- convert outputs" << endl;
-  Tensor<float> tensor_imgoutput;
-  bool ret = true;
-  ret = tensor_imgoutput.FromArray(img_output, kDimImageOutput);
-  if (!ret) {
-    ERROR_LOG("Failed to resolve tensor from array.");
+  const uint32_t shape[3] = {
+      planar_output_ ? channels : (uint32_t) output_height_,
+      planar_output_ ? (uint32_t) output_height_ : (uint32_t) output_width_,
+      planar_output_ ? (uint32_t) output_width_ : channels };
+
+  // lower resolution model, upsample mask to output shape
+  if (mask_width != output_width_ || mask_height != output_height_) {
+    Tensor<float, 3> &upsampled_mask = workspace_.Mask();
+    if (!upsampled_mask.Resize(shape)) {
+      ERROR_LOG("Failed to allocate upsampled mask.");
+      return false;
+    }
+    workspace_.Track();
+    cv::Size output_size(output_width_, output_height_);
+    if (planar_output_) {
+      for (uint32_t c = 0; c < channels; ++c) {
+        cv::Mat mask(mask_height, mask_width, CV_32FC1,
+                     img_output + c * mask_width * mask_height);
+        cv::Mat upsampled(output_size, CV_32FC1,
+                          upsampled_mask.Data() + c * OutputPlane());
+        cv::resize(mask, upsampled, output_size, 0, 0, cv::INTER_LINEAR);
+      }
+    } else {
+      cv::Mat mask(mask_height, mask_width, CV_32FC(channels), img_output);
+      cv::Mat upsampled(output_size, CV_32FC(channels),
+                        upsampled_mask.Data());
+      cv::resize(mask, upsampled, output_size, 0, 0, cv::INTER_LINEAR);
+    }
+    img_output = upsampled_mask.Data();
+    mask_size = upsampled_mask.Size() * sizeof(float);
+  }
+
+  vector<uint32_t> dims(shape, shape + 3);
+  if (!output.Reset(img_output, mask_size, dims)) {
+    ERROR_LOG("Failed to view output tensor.");
+    return false;
+  }
+  if (mask_stats_) {
+    UpdateMaskStats(output);
+  }
+  return true;
+}
+
+void GeneralPost::UpdateMaskStats(const TensorView<const float> &output) {
+  for (uint32_t row = 0; row < (uint32_t) output_height_; row++) {
+    road_mask_.FromProbability(row, ProbRow(output, row), ProbStride(),
+                               road_threshold_);
+  }
+  mask_area_total_ += road_mask_.Count();
+  if (mask_stats_frames_ > 0) {
+    mask_iou_total_ += road_mask_.IoU(previous_road_mask_);
+  }
+  mask_stats_frames_++;
+  swap(road_mask_, previous_road_mask_);
+}
+
+uint32_t GeneralPost::OutputPlane() const {
+  return output_width_ * output_height_;
+}
+
+const float *GeneralPost::ProbRow(const TensorView<const float> &output,
+                                  uint32_t row) const {
+  return planar_output_ ? output.Data() + row * output_width_
+      : output.Row(row);
+}
+
+uint32_t GeneralPost::ProbStride() const {
+  return planar_output_ ? 1 : channels_;
+}
+
+void GeneralPost::ClassRow(const TensorView<const float> &output,
+                           uint32_t row, uint8_t *index,
+                           uint8_t *scratch) const {
+  if (planar_output_) {
+    classmap::ArgmaxPlanar(ProbRow(output, row), OutputPlane(), channels_,
+                           output_width_, index);
+  } else {
+    classmap::ArgmaxInterleaved(ProbRow(output, row), channels_,
+                                output_width_, index,
+                                reinterpret_cast<float *>(scratch));
+  }
+}
+
+void GeneralPost::RenderRows(const TensorView<const float> &output,
+                             const ImageInfo *frame, cv::Mat &image,
+                             bool bgr, uint32_t begin, uint32_t end) {
+  pool_->Run(end - begin, image.step,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    first += begin;
+    last += begin;
+    uint8_t *rows = image.data + first * image.step;
+    // road region of camera frame is twice the output, convert only it
+    if (frame != nullptr) {
+      color::Nv21RegionToRgbHalf(frame->data.get(), frame->width,
+                                 frame->height, kRoiLeft,
+                                 kRoiTop + first * 2, rows, output_width_,
+                                 last - first, image.step);
+    }
+    uint8_t *scratch = workspace_.Scratch(worker);
+    if (!class_overlay_ && stabilizer_ != nullptr) {
+      // probability row goes through the stabilizer while in cache
+      for (uint32_t row = first; row < last; row++) {
+        uint8_t *pixels = image.data + row * image.step;
+        overlay::ProbabilityToFixed(ProbRow(output, row), ProbStride(),
+                                    scratch, output_width_);
+        stabilizer_->UpdateRow(row, scratch);
+        overlay::BlendFixedRow(scratch, pixels, pixels, output_width_);
+      }
+      return;
+    }
+    if (!class_overlay_) {
+      overlay::BlendImage(ProbRow(output, first), ProbStride(), rows,
+                          image.step, rows, image.step, output_width_,
+                          last - first, scratch);
+      return;
+    }
+    // class row, then planar channels behind it
+    const classmap::Palette &palette = bgr ? palette_bgr_ : palette_rgb_;
+    for (uint32_t row = first; row < last; row++) {
+      uint8_t *pixels = image.data + row * image.step;
+      ClassRow(output, row, scratch, scratch + output_width_ * 4);
+      classmap::Colorize(scratch, palette, pixels, pixels, output_width_);
+    }
+  });
+}
+
+bool GeneralPost::SendFrame(uint16_t encoding, uint16_t flags,
+                            uint32_t width, uint32_t height,
+                            const struct iovec *parts, int count) {
+  FrameHeader header;
+  header.encoding = encoding;
+  header.frame_id = frame_id_;
+  header.width = width;
+  header.height = height;
+  header.timestamp_us = timestamp_us_;
+  header.flags = flags;
+  header.reserved = 0;
+  return sender_->Post(header, parts, count);
+}
+
+bool GeneralPost::OverlayWanted() {
+  return sender_->Connected() && sender_->Subscribed();
+}
+
+void GeneralPost::RenderFullRows(const TensorView<const float> &output,
+                                 const ImageInfo &frame, cv::Mat &image,
+                                 uint32_t begin, uint32_t end) {
+  const uint32_t roi_end = kRoiTop + output_height_ * 2;
+  pool_->Run(end - begin, image.step,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    first += begin;
+    last += begin;
+    color::Nv21RowsToRgb(frame.data.get(), frame.width, frame.height, first,
+                         last - first, image.data + first * image.step,
+                         image.step);
+    // mask covers the road region at half its resolution, rows outside
+    // it are left as converted
+    for (uint32_t row = max(first, kRoiTop); row < min(last, roi_end);
+         row++) {
+      uint32_t y = row - kRoiTop;
+      uint32_t near = y >> 1;
+      uint32_t far = near;
+      if ((y & 1) != 0 && near + 1 < (uint32_t) output_height_) {
+        far = near + 1;
+      } else if ((y & 1) == 0 && near > 0) {
+        far = near - 1;
+      }
+      uint8_t *pixels = image.data + row * image.step + kRoiLeft * 3;
+      uint8_t *scratch = workspace_.Scratch(worker);
+      if (!class_overlay_ && stabilizer_ != nullptr) {
+        // stable mask rows, upsampled as 8-bit probability
+        uint32_t width = output_width_ * 2;
+        uint16_t *column = reinterpret_cast<uint16_t *>(
+            scratch + ScratchOffset(width));
+        overlay::UpsampleRow2x(stabilizer_->MaskRow(near),
+                               stabilizer_->MaskRow(far), scratch,
+                               output_width_, column);
+        overlay::BlendFixedRow(scratch, pixels, pixels, width);
+        continue;
+      }
+      if (!class_overlay_) {
+        overlay::BlendUpsampledRow(ProbRow(output, near), ProbRow(output, far),
+                                   ProbStride(), pixels, output_width_,
+                                   scratch);
+        continue;
+      }
+      // classes are not interpolated, nearest row and column
+      uint8_t *upsampled = scratch + output_width_;
+      ClassRow(output, near, scratch, scratch + output_width_ * 4);
+      classmap::Upsample2x(scratch, upsampled, output_width_);
+      classmap::Colorize(upsampled, palette_rgb_, pixels, pixels,
+                         output_width_ * 2);
+    }
+  });
+}
+
+void GeneralPost::StabilizeMask(const TensorView<const float> &output) {
+  pool_->Run(output_height_, output_width_,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    uint8_t *scratch = workspace_.Scratch(worker);
+    for (uint32_t row = first; row < last; row++) {
+      overlay::ProbabilityToFixed(ProbRow(output, row), ProbStride(), scratch,
+                                  output_width_);
+      stabilizer_->UpdateRow(row, scratch);
+    }
+  });
+}
+
+void GeneralPost::SendImage(cv::Mat &image, uint16_t flags,
+                            const RenderFunc &render) {
+  frame_id_++;
+  uint32_t height = image.rows;
+  uint32_t stripe_rows = (stripe_rows_ == 0) ? height : stripe_rows_;
+  for (uint32_t row = 0; row < height; row += stripe_rows) {
+    uint32_t rows = min(stripe_rows, height - row);
+    render(row, row + rows);
+    // image is continuous, rows are back to back
+    uint8_t *payload = image.data + row * image.step;
+    uint32_t payload_size = rows * image.step;
+    struct iovec parts[2];
+    if (stripe_rows_ != 0) {
+      StripeHeader header;
+      header.magic = kStripeMagic;
+      header.frame_id = frame_id_;
+      header.width = image.cols;
+      header.height = height;
+      header.row = row;
+      header.rows = rows;
+      header.bytes = payload_size;
+      parts[0].iov_base = &header;
+      parts[0].iov_len = sizeof(header);
+      parts[1].iov_base = payload;
+      parts[1].iov_len = payload_size;
+      // a dropped stripe leaves its rows of the previous frame
+      SendFrame(kEncodingStripe, flags, image.cols, height, parts, 2);
+      continue;
+    }
+    parts[0].iov_base = payload;
+    parts[0].iov_len = payload_size;
+    SendFrame(kEncodingImage, flags, image.cols, height, parts, 1);
+  }
+  // rendered rows of this frame are in the average
+  if (stabilizer_ != nullptr) {
+    stabilizer_->EndFrame();
+  }
+}
+
+HIAI_StatusT GeneralPost::ModelPostProcessCap(const shared_ptr<EngineTrans> &result) {
+
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
     return HIAI_ERROR;
   }
   // cout << "--post-- get outputs" << endl;
   // cout << "--post-- unsigned char to mat" << endl;
-  uint8_t* pdata = result->image_info.data.get();
-  cv::Mat yuvImg;
-  yuvImg.create(result->image_info.height*3/2, result->image_info.width, CV_8UC1);
-  memcpy(yuvImg.data, pdata, result->image_info.size);
-  cv::Mat mat;
-  cv::cvtColor(yuvImg, mat, CV_YUV2RGB_NV21);
-  // crop image
-  cv::Rect rect(0,176,1246,376);
-  cv::Mat imageCrop = mat(rect);
-  // resize iamge
-  cv::resize(imageCrop, imageCrop, cv::Size(623, 188));
-  stringstream sstream;
-
-  // cout << "--post-- start mat change" << endl;
-  cv::Vec3b pVec3b;
-  for (int i = 0; i < 188; i++) {
-    for (int j = 0; j < 623; j++) {
-      float resultValue = tensor_imgoutput(i*623+j, 0)*255.0;
-      cv::Vec3b pNow = imageCrop.at<cv::Vec3b>(i, j);
-      pVec3b[0] = (int) (0.4*resultValue+0.6*pNow[0]);
-      pVec3b[1] = pNow[1];
-      pVec3b[2] = (int) (0.4*(255.0-resultValue)+0.6*pNow[2]);
-      if (pVec3b[0]>255) pVec3b[0]=255;
-      if (pVec3b[1]>255) pVec3b[1]=255;
-      if (pVec3b[2]>255) pVec3b[2]=255;
-      imageCrop.at<cv::Vec3b>(i, j) = pVec3b;
-    }
+  const ImageInfo &image_info = result->image_info;
+  uint8_t* pdata = image_info.data.get();
+  if (pdata == nullptr || image_info.width <= 0 || image_info.height <= 0
+      || image_info.size < image_info.width * image_info.height * 3 / 2) {
+    ERROR_LOG("Invalid camera frame, size %d.", image_info.size);
+    return HIAI_ERROR;
   }
-  // cout << "--post-- mat changed!!" << endl;
-  int bytes = 0;
-  int image_size = imageCrop.total() * imageCrop.elemSize();
-  // cout << "--post-- send image to server, image_size: " << image_size << endl;
-  if ((bytes = send(sokt, imageCrop.data, image_size, 0)) < 0){
-    close(sokt);
-    cout << "bytes = " << bytes << endl;
+  cv::Mat &imageCrop = workspace_.Image();
+  if (!image_info.preprocessed) {
+    if (kRoiLeft + output_width_ * 2 > (uint32_t) image_info.width
+        || kRoiTop + output_height_ * 2 > (uint32_t) image_info.height) {
+      ERROR_LOG("Camera frame %dx%d is smaller than road region.",
+                image_info.width, image_info.height);
+      return HIAI_ERROR;
+    }
+    if (full_overlay_) {
+      // whole camera frame, mask upsampled onto the road region
+      cv::Mat &frame = workspace_.Frame(image_info.width, image_info.height);
+      // mask rows are read by up to four image rows, update them first
+      if (stabilizer_ != nullptr && !class_overlay_) {
+        StabilizeMask(tensor_imgoutput);
+      }
+      SendImage(frame, 0, [&](uint32_t begin, uint32_t end) {
+        RenderFullRows(tensor_imgoutput, image_info, frame, begin, end);
+      });
+      return HIAI_OK;
+    }
+    // converted band by band together with the blend
+    SendImage(imageCrop, 0, [&](uint32_t begin, uint32_t end) {
+      RenderRows(tensor_imgoutput, &image_info, imageCrop, false, begin,
+                 end);
+    });
+  } else {
+    // host pre-processed frame is the road region already, only resize
+    cv::Mat yuvImg(image_info.height * 3 / 2, image_info.width, CV_8UC1,
+                   pdata);
+    cv::Mat &mat = workspace_.Frame(image_info.width, image_info.height);
+    cv::cvtColor(yuvImg, mat, CV_YUV2RGB_NV21);
+    cv::resize(mat, imageCrop, imageCrop.size());
+    SendImage(imageCrop, 0, [&](uint32_t begin, uint32_t end) {
+      RenderRows(tensor_imgoutput, nullptr, imageCrop, false, begin, end);
+    });
   }
   return HIAI_OK;
 }
 
 HIAI_StatusT GeneralPost::ModelPostProcessPic(const shared_ptr<EngineTrans> &result) {
 
-  vector<Output> outputs = result->inference_res;
-  
-  if (outputs.size() != kOutputTensorSize) {
-    ERROR_LOG("Detection output size does not match.");
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
     return HIAI_ERROR;
   }
-  // cout << "start get outputs" << endl;
-  float *img_output = reinterpret_cast<float *>(outputs[0].data.get());
-  // cout << "convert outputs" << endl;
-  Tensor<float> tensor_imgoutput;
-  bool ret = true;
-  ret = tensor_imgoutput.FromArray(img_output, kDimImageOutput);
-  if (!ret) {
-    ERROR_LOG("Failed to resolve tensor from array.");
+  // cout << "get outputs" << endl;
+
+  // decoded BGR frame travels with the result, post is its last user
+  const ImageInfo &image_info = result->image_info;
+  if (image_info.data == nullptr || image_info.width <= 0
+      || image_info.height <= 0
+      || image_info.size < image_info.width * image_info.height * 3) {
+    ERROR_LOG("Invalid picture %s, size %d.", image_info.path.c_str(),
+              image_info.size);
     return HIAI_ERROR;
   }
-  // cout << "get outputs" << endl;
+  cv::Mat mat(image_info.height, image_info.width, CV_8UC3,
+              image_info.data.get());
+  if (mat.cols != output_width_ || mat.rows != output_height_) {
+    cv::resize(mat, workspace_.Image(), workspace_.Image().size());
+    mat = workspace_.Image();
+  }
+
+  SendImage(mat, kFrameBgr, [&](uint32_t begin, uint32_t end) {
+    // pictures are BGR
+    RenderRows(tensor_imgoutput, nullptr, mat, true, begin, end);
+  });
+  return HIAI_OK;
+}
+
+void GeneralPost::BuildRoadMask(const TensorView<const float> &output,
+                                cv::Mat &mask) {
+  pool_->Run(output_height_, mask.step,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    for (uint32_t row = first; row < last; row++) {
+      uint8_t *levels = mask.ptr<uint8_t>(row);
+      overlay::ProbabilityToFixed(ProbRow(output, row), ProbStride(), levels,
+                                  output_width_);
+      if (stabilizer_ != nullptr) {
+        stabilizer_->UpdateRow(row, levels);
+      }
+    }
+  });
+  if (stabilizer_ != nullptr) {
+    stabilizer_->EndFrame();
+    return;
+  }
+  // level or above is road
+  cv::threshold(mask, mask, road_level_ - 1.0, 255, cv::THRESH_BINARY);
+}
+
+HIAI_StatusT GeneralPost::ModelPostProcessSkip(
+    const shared_ptr<EngineTrans> &result) {
+  overlay_skipped_++;
+  if (stabilizer_ == nullptr && !mask_stats_) {
+    return HIAI_OK;
+  }
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
+    return HIAI_ERROR;
+  }
+  if (stabilizer_ == nullptr) {
+    return HIAI_OK;
+  }
+  // mask history stays current for when the viewer comes back
+  StabilizeMask(tensor_imgoutput);
+  stabilizer_->EndFrame();
+  return HIAI_OK;
+}
+
+HIAI_StatusT GeneralPost::ModelPostProcessPolygon(
+    const shared_ptr<EngineTrans> &result) {
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
+    return HIAI_ERROR;
+  }
+  frame_id_++;
+  cv::Mat &mask = workspace_.RoadMask();
+  BuildRoadMask(tensor_imgoutput, mask);
+  // outer contours only, mask is scratch from here
+  cv::findContours(mask, contours_, cv::RETR_EXTERNAL,
+                   cv::CHAIN_APPROX_SIMPLE);
+  double largest_area = 0.0;
+  int32_t largest = -1;
+  for (size_t index = 0; index < contours_.size(); index++) {
+    double area = cv::contourArea(contours_[index]);
+    if (largest < 0 || area > largest_area) {
+      largest_area = area;
+      largest = index;
+    }
+  }
+  polygon_.clear();
+  if (largest >= 0) {
+    cv::approxPolyDP(contours_[largest], polygon_, polygon_epsilon_, true);
+  }
+  uint16_t points = min(polygon_.size(), (size_t) UINT16_MAX);
+  PolygonHeader header;
+  header.magic = kPolygonMagic;
+  header.frame_id = frame_id_;
+  header.width = output_width_;
+  header.height = output_height_;
+  header.points = points;
+  header.reserved = 0;
+  header.area = static_cast<uint32_t>(largest_area);
+  // one frame of header and points
+  record_.resize(sizeof(header) + points * sizeof(int16_t) * 2);
+  memcpy(record_.data(), &header, sizeof(header));
+  int16_t *xy = reinterpret_cast<int16_t *>(record_.data() + sizeof(header));
+  for (uint32_t index = 0; index < points; index++) {
+    xy[index * 2] = static_cast<int16_t>(polygon_[index].x);
+    xy[index * 2 + 1] = static_cast<int16_t>(polygon_[index].y);
+  }
+  SendRecord(kEncodingPolygon, output_width_, output_height_);
+  return HIAI_OK;
+}
 
-  cv::Mat mat = cv::imread(result->image_info.path, CV_LOAD_IMAGE_UNCHANGED);
-  stringstream sstream;
-
-  // cout << "start mat change!!" << endl;
-  cv::Vec3b pVec3b;
-  for (int i = 0; i < 188; i++) {
-    for (int j = 0; j < 623; j++) {
-      float resultValue = tensor_imgoutput(i*623+j, 0)*255.0;
-      cv::Vec3b pNow = mat.at<cv::Vec3b>(i, j);
-      pVec3b[0] = (int) (0.4*resultValue+0.6*pNow[0]);
-      pVec3b[1] = pNow[1];
-      pVec3b[2] = (int) (0.4*(255.0-resultValue)+0.6*pNow[2]);
-      if (pVec3b[0]>255) pVec3b[0]=255;
-      if (pVec3b[1]>255) pVec3b[1]=255;
-      if (pVec3b[2]>255) pVec3b[2]=255;
-      mat.at<cv::Vec3b>(i, j) = pVec3b;
+HIAI_StatusT GeneralPost::ModelPostProcessFreeSpace(
+    const shared_ptr<EngineTrans> &result) {
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
+    return HIAI_ERROR;
+  }
+  frame_id_++;
+  boundary_.resize(output_width_);
+  confidence_.resize(output_width_);
+  freespace::ScanReset(boundary_.data(), confidence_.data(), output_width_,
+                       output_height_);
+  // bottom-up and stops at the highest boundary, one thread is enough
+  uint8_t *prob = workspace_.Scratch(0);
+  uint8_t *road = prob + ScratchOffset(output_width_);
+  bool open = true;
+  for (int32_t row = output_height_ - 1; row >= 0; row--) {
+    // stabilizer needs every row, the scan only rows up to the boundary
+    if (!open && stabilizer_ == nullptr) {
+      break;
+    }
+    overlay::ProbabilityToFixed(ProbRow(tensor_imgoutput, row), ProbStride(),
+                                prob, output_width_);
+    if (stabilizer_ == nullptr) {
+      open = freespace::ScanRow(prob, prob, row, road_level_,
+                                boundary_.data(), confidence_.data(),
+                                output_width_);
+      continue;
     }
+    memcpy(road, prob, output_width_);
+    stabilizer_->UpdateRow(row, road);
+    if (open) {
+      open = freespace::ScanRow(road, prob, row, kStableRoadLevel,
+                                boundary_.data(), confidence_.data(),
+                                output_width_);
+    }
+  }
+  if (stabilizer_ != nullptr) {
+    stabilizer_->EndFrame();
   }
-  // cout << "mat changed!!" << endl;
-  int bytes = 0;
-  int image_size = mat.total() * mat.elemSize();
-  // cout << "--post-- send image to server, image_size: " << image_size << endl;
-  if ((bytes = send(sokt, mat.data, image_size, 0)) < 0){
-    close(sokt);
-    cout << "bytes = " << bytes << endl;
+  freespace::ScanFinish(boundary_.data(), confidence_.data(), output_width_,
+                        output_height_);
+  uint32_t boundary_bytes = output_width_ * sizeof(uint16_t);
+  uint32_t confidence_bytes = freespace_confidence_ ? output_width_ : 0;
+  FreeSpaceHeader header;
+  header.magic = kFreeSpaceMagic;
+  header.frame_id = frame_id_;
+  header.width = output_width_;
+  header.height = output_height_;
+  header.flags = freespace_confidence_ ? kFreeSpaceConfidence : 0;
+  header.reserved = 0;
+  header.bytes = boundary_bytes + confidence_bytes;
+  // one frame of header and payload
+  record_.resize(sizeof(header) + header.bytes);
+  memcpy(record_.data(), &header, sizeof(header));
+  memcpy(record_.data() + sizeof(header), boundary_.data(), boundary_bytes);
+  memcpy(record_.data() + sizeof(header) + boundary_bytes,
+         confidence_.data(), confidence_bytes);
+  SendRecord(kEncodingFreeSpace, output_width_, output_height_);
+  return HIAI_OK;
+}
+
+HIAI_StatusT GeneralPost::ModelPostProcessBev(
+    const shared_ptr<EngineTrans> &result) {
+  TensorView<const float> tensor_imgoutput;
+  if (!ArrangeOutput(result, tensor_imgoutput)) {
+    return HIAI_ERROR;
+  }
+  frame_id_++;
+  // 8-bit levels inside the zero border of the padded mask
+  uint32_t step = bev::PaddedStep(output_width_);
+  pool_->Run(output_height_, step,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    for (uint32_t row = first; row < last; row++) {
+      uint8_t *levels = &bev_mask_[(row + 1) * step + 1];
+      overlay::ProbabilityToFixed(ProbRow(tensor_imgoutput, row),
+                                  ProbStride(), levels, output_width_);
+      if (stabilizer_ != nullptr) {
+        stabilizer_->UpdateRow(row, levels);
+      }
+    }
+  });
+  if (stabilizer_ != nullptr) {
+    stabilizer_->EndFrame();
   }
+  BevHeader header;
+  header.magic = kBevMagic;
+  header.frame_id = frame_id_;
+  header.width = bev_width_;
+  header.height = bev_height_;
+  header.reserved[0] = 0;
+  header.reserved[1] = 0;
+  header.bytes = bev_width_ * bev_height_;
+  // cells are gathered straight into the record
+  record_.resize(sizeof(header) + header.bytes);
+  memcpy(record_.data(), &header, sizeof(header));
+  uint8_t *cells = record_.data() + sizeof(header);
+  pool_->Run(bev_height_, bev_width_,
+             [&](uint32_t worker, uint32_t first, uint32_t last) {
+    bev::Gather(&bev_table_[first * bev_width_], bev_mask_.data(), step,
+                cells + first * bev_width_, (last - first) * bev_width_);
+  });
+  SendRecord(kEncodingBev, bev_width_, bev_height_);
   return HIAI_OK;
 }
 
@@ -248,7 +998,9 @@ HIAI_IMPL_ENGINE_PROCESS("general_post", GeneralPost, INPUT_SIZE) {
   shared_ptr<EngineTrans> result = static_pointer_cast<EngineTrans>(arg0);
   if (result->is_finished) {
     cout << "--post-- finished" << endl;
-    close(sokt);
+    // queued frames go out before the connection closes
+    sender_->Stop();
+    INFO_LOG("--post-- sender: %s", sender_->ToString().c_str());
     if (SendSentinel()) {
       return HIAI_OK;
     }
@@ -262,7 +1014,62 @@ HIAI_IMPL_ENGINE_PROCESS("general_post", GeneralPost, INPUT_SIZE) {
     ERROR_LOG("%s", result->err_msg.err_msg.c_str());
     return HIAI_ERROR;
   }
+  // every frame paces the report, picture mode has no capture timestamp
+  post_frames_++;
+  bool report = (post_frames_ % kLatencyReportInterval == 0);
+  // capture to post latency, both engines run on host
+  if (result->image_info.timestamp_us > 0) {
+    latency_frames_++;
+    latency_total_ms_ += (SteadyNowUs() - result->image_info.timestamp_us)
+        / 1000.0;
+  }
+  if (report) {
+    INFO_LOG("--post-- frames:%lu", (unsigned long) post_frames_);
+    if (latency_frames_ > 0) {
+      INFO_LOG("--post-- capture to post latency ms:%.3f over %lu frames",
+               latency_total_ms_ / latency_frames_,
+               (unsigned long) latency_frames_);
+    }
+    INFO_LOG("--post-- overlay rendered:%lu, skipped:%lu",
+             (unsigned long) overlay_rendered_,
+             (unsigned long) overlay_skipped_);
+    if (mask_stats_frames_ > 1) {
+      INFO_LOG("--post-- road area mean:%.1f, frame to frame IoU mean:%.4f",
+               mask_area_total_ / mask_stats_frames_,
+               mask_iou_total_ / (mask_stats_frames_ - 1));
+    }
+    INFO_LOG("--post-- sender: %s", sender_->ToString().c_str());
+    INFO_LOG("--post-- workers: %s", pool_->ToString().c_str());
+    INFO_LOG("--post-- workspace: %s", workspace_.ToString().c_str());
+    if (stabilizer_ != nullptr) {
+      INFO_LOG("--post-- stabilizer: %s", stabilizer_->ToString().c_str());
+    }
+  }
+
+  timestamp_us_ = result->image_info.timestamp_us;
+
+  // shape of full resolution model, buffers follow it
+  const OutputDims &full_dims = result->full_dims;
+  if (full_dims.width > 0 && full_dims.height > 0
+      && !Reshape(full_dims.width, full_dims.height)) {
+    return HIAI_ERROR;
+  }
+
   // arrange result
+  if (output_format_ == kOutputPolygon) {
+    return ModelPostProcessPolygon(result);
+  }
+  if (output_format_ == kOutputFreeSpace) {
+    return ModelPostProcessFreeSpace(result);
+  }
+  if (output_format_ == kOutputBev) {
+    return ModelPostProcessBev(result);
+  }
+  // no conversion, resize or blend unless a viewer wants the image
+  if (!OverlayWanted()) {
+    return ModelPostProcessSkip(result);
+  }
+  overlay_rendered_++;
   if (result->image_info.mode==0) {
     return ModelPostProcessCap(result);
   }
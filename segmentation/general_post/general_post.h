@@ -35,9 +35,22 @@
 #define GENERAL_POST_GENERAL_POST_H_
 
 #include<vector>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
 #include "hiaiengine/engine.h"
 #include "hiaiengine/data_type.h"
 #include "data_type.h"
+#include "class_kernel.h"
+#include "frame_sender.h"
+#include "mask_stabilizer.h"
+#include "opencv2/opencv.hpp"
+#include "packed_mask.h"
+#include "worker_pool.h"
 
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -45,67 +58,423 @@
 #define INPUT_SIZE 1
 #define OUTPUT_SIZE 1
 
-template <class T>
+/**
+ * @brief: compile time row-major shape, dims and strides are constexpr
+ */
+template <uint32_t... Dims>
+struct StaticShape;
+
+template <>
+struct StaticShape<> {
+  static constexpr uint32_t Rank() { return 0; }
+  static constexpr uint32_t Size() { return 1; }
+  static constexpr uint32_t Dim(uint32_t) { return 0; }
+  static constexpr uint32_t Stride(uint32_t) { return 1; }
+  static constexpr uint32_t Offset() { return 0; }
+};
+
+template <uint32_t First, uint32_t... Rest>
+struct StaticShape<First, Rest...> {
+  typedef StaticShape<Rest...> Inner;
+
+  static constexpr uint32_t Rank() { return 1 + sizeof...(Rest); }
+  static constexpr uint32_t Size() { return First * Inner::Size(); }
+  static constexpr uint32_t Dim(uint32_t idx) {
+    return idx == 0 ? First : Inner::Dim(idx - 1);
+  }
+  static constexpr uint32_t Stride(uint32_t idx) {
+    return idx == 0 ? Inner::Size() : Inner::Stride(idx - 1);
+  }
+  template <class... Idx>
+  static constexpr uint32_t Offset(uint32_t i, Idx... rest) {
+    return i * Inner::Size() + Inner::Offset(rest...);
+  }
+};
+
+/**
+ * @brief: owning row-major tensor of fixed rank, storage is 64-byte
+ *         aligned and reused when resized to a smaller or equal size.
+ *         Movable, not copyable
+ */
+template <class T, uint32_t Rank>
 class Tensor {
   public:
-    Tensor() : data_(nullptr) {}
+    static const uint32_t kAlignment = 64;
+
+    Tensor() : data_(nullptr), size_(0), capacity_(0) {
+      for (uint32_t idx = 0; idx < Rank; ++idx) {
+        dims_[idx] = 0;
+        strides_[idx] = 0;
+      }
+    }
     ~Tensor() { Clear(); }
 
-    uint32_t Size() const {
-      uint32_t size(1);
-      for(auto& dim : dims_){
-        size *= dim;
+    Tensor(const Tensor&) = delete;
+    Tensor& operator=(const Tensor&) = delete;
+
+    Tensor(Tensor&& other) noexcept : Tensor() { Swap(other); }
+    Tensor& operator=(Tensor&& other) noexcept {
+      if (this != &other) {
+        Clear();
+        Swap(other);
       }
-      return size;
+      return *this;
     }
 
-    bool FromArray(const T* pdata, const std::vector<uint32_t>& shape){
-      if(pdata == nullptr){
+    /**
+     * @brief: set shape, allocate when capacity is not enough
+     * @param [in]: shape: dims, row-major
+     * @return: true: success; false: zero dim, more than UINT32_MAX
+     *          elements or allocation failed, tensor is unchanged
+     */
+    bool Resize(const uint32_t (&shape)[Rank]) {
+      uint32_t dims[Rank];
+      uint32_t strides[Rank];
+      uint64_t size(1);
+      for (uint32_t idx = Rank; idx-- > 0;) {
+        if (shape[idx] == 0) {
+          return false;
+        }
+        dims[idx] = shape[idx];
+        strides[idx] = static_cast<uint32_t>(size);
+        size *= shape[idx];
+        // sizes and offsets are 32-bit
+        if (size > UINT32_MAX) {
+          return false;
+        }
+      }
+      if (size > capacity_) {
+        if (size > (SIZE_MAX - kAlignment) / sizeof(T)) {
+          return false;
+        }
+        void* buffer = nullptr;
+        size_t bytes = (static_cast<size_t>(size) * sizeof(T) + kAlignment
+            - 1) / kAlignment * kAlignment;
+        if (posix_memalign(&buffer, kAlignment, bytes) != 0) {
+          return false;
+        }
+        Clear();
+        data_ = static_cast<T*>(buffer);
+        capacity_ = static_cast<uint32_t>(size);
+      }
+      for (uint32_t idx = 0; idx < Rank; ++idx) {
+        dims_[idx] = dims[idx];
+        strides_[idx] = strides[idx];
+      }
+      size_ = static_cast<uint32_t>(size);
+      return true;
+    }
+
+    /**
+     * @brief: set compile time shape
+     */
+    template <uint32_t... Dims>
+    bool Resize(StaticShape<Dims...>) {
+      static_assert(sizeof...(Dims) == Rank, "shape rank mismatch");
+      const uint32_t shape[Rank] = {Dims...};
+      return Resize(shape);
+    }
+
+    uint32_t Size() const { return size_; }
+    uint32_t Dim(uint32_t idx) const { assert(idx < Rank); return dims_[idx]; }
+    uint32_t Stride(uint32_t idx) const {
+      assert(idx < Rank);
+      return strides_[idx];
+    }
+    T* Data() { return data_; }
+    const T* Data() const { return data_; }
+
+    /**
+     * @brief: element access, one index per dim
+     */
+    template <class... Idx>
+    T& operator()(Idx... idx) {
+      static_assert(sizeof...(Idx) == Rank, "index rank mismatch");
+      return data_[Offset(0, idx...)];
+    }
+    template <class... Idx>
+    const T& operator()(Idx... idx) const {
+      static_assert(sizeof...(Idx) == Rank, "index rank mismatch");
+      return data_[Offset(0, idx...)];
+    }
+
+    T& operator[](uint32_t index) { assert(index < size_); return data_[index]; }
+    const T& operator[](uint32_t index) const {
+      assert(index < size_);
+      return data_[index];
+    }
+
+  private:
+    uint32_t Offset(uint32_t) const { return 0; }
+
+    template <class... Idx>
+    uint32_t Offset(uint32_t dim, uint32_t i, Idx... rest) const {
+      assert(i < dims_[dim]);
+      return i * strides_[dim] + Offset(dim + 1, rest...);
+    }
+
+    void Swap(Tensor& other) {
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+      std::swap(capacity_, other.capacity_);
+      for (uint32_t idx = 0; idx < Rank; ++idx) {
+        std::swap(dims_[idx], other.dims_[idx]);
+        std::swap(strides_[idx], other.strides_[idx]);
+      }
+    }
+
+    void Clear() {
+      free(data_);
+      data_ = nullptr;
+      size_ = 0;
+      capacity_ = 0;
+    }
+
+    T* data_; // tensor data, kAlignment aligned
+    uint32_t size_;
+    uint32_t capacity_;
+    uint32_t dims_[Rank]; // tensor shape
+    uint32_t strides_[Rank];
+};
+
+/**
+ * @brief: non-owning strided view over a tensor buffer, e.g. Output::data.
+ *         Access is bounds checked in debug builds (assert) only
+ */
+template <class T>
+class TensorView {
+  public:
+    static const uint32_t kMaxRank = 4;
+
+    TensorView() : data_(nullptr), rank_(0), size_(0) {}
+
+    /**
+     * @brief: wrap buffer, shape must cover exactly bytes
+     * @param [in]: data: first element, not owned
+     * @param [in]: bytes: buffer size in bytes
+     * @param [in]: shape: dims, row-major
+     * @return: true: success; false: failed
+     */
+    bool Reset(T* data, uint32_t bytes, const std::vector<uint32_t>& shape) {
+      if (data == nullptr || shape.empty() || shape.size() > kMaxRank) {
         return false;
       }
-      Clear();
       uint32_t size(1);
-      for(auto dim:shape){
-        if(dim>0){
-          size *= dim;
-        }else{
+      for (uint32_t idx = shape.size(); idx-- > 0;) {
+        if (shape[idx] == 0) {
           return false;
         }
+        dims_[idx] = shape[idx];
+        strides_[idx] = size;
+        size *= shape[idx];
       }
-      data_ = new T[size];
-      int ret = memcpy_s(data_, size * sizeof(T), pdata, size * sizeof(T));
-      if(ret !=0){
+      if (size * sizeof(T) != bytes) {
         return false;
       }
-      dims_ = shape;
+      data_ = data;
+      rank_ = shape.size();
+      size_ = size;
       return true;
     }
 
-    T& operator()(uint32_t i, ...) { 
-      va_list arg_ptr;
-      va_start(arg_ptr, i);
-      uint32_t index = i;
-      for (uint32_t idx = 1; idx < dims_.size();++idx){
-        index *= dims_[idx];
-        index += va_arg(arg_ptr, uint32_t);
-      }
-      va_end(arg_ptr);
-      return data_[index];
+    uint32_t Size() const { return size_; }
+    uint32_t Rank() const { return rank_; }
+    uint32_t Dim(uint32_t idx) const { assert(idx < rank_); return dims_[idx]; }
+    uint32_t Stride(uint32_t idx) const {
+      assert(idx < rank_);
+      return strides_[idx];
+    }
+    T* Data() const { return data_; }
+
+    /**
+     * @brief: first element of slice i along the first dim
+     */
+    T* Row(uint32_t i) const {
+      assert(rank_ > 0 && i < dims_[0]);
+      return data_ + i * strides_[0];
     }
 
-    T& operator[](unsigned int index) { return data_[index]; }
-    const T& operator[](unsigned int index) const { return data_[index]; }
+    T& operator()(uint32_t i, uint32_t j) const {
+      assert(rank_ == 2 && i < dims_[0] && j < dims_[1]);
+      return data_[i * strides_[0] + j];
+    }
 
-  private:
-    void Clear(){
-      if(data_ != nullptr){
-        delete[] data_;
-        data_ = nullptr;
-      }
-      dims_.clear();
+    T& operator()(uint32_t i, uint32_t j, uint32_t k) const {
+      assert(rank_ == 3 && i < dims_[0] && j < dims_[1] && k < dims_[2]);
+      return data_[i * strides_[0] + j * strides_[1] + k];
+    }
+
+    T& operator[](uint32_t index) const {
+      assert(index < size_);
+      return data_[index];
     }
-    std::vector<uint32_t> dims_; // tensor shape
-    T* data_; //tensor data
+
+  private:
+    T* data_; // not owned
+    uint32_t rank_;
+    uint32_t size_;
+    uint32_t dims_[kMaxRank];
+    uint32_t strides_[kMaxRank];
+};
+
+/**
+ * @brief: header before every stripe in stripe streaming mode, host byte
+ *         order, followed by bytes of rows * width * 3
+ */
+struct StripeHeader {
+  uint32_t magic;
+  uint32_t frame_id;
+  uint16_t width;  // frame width
+  uint16_t height; // frame height
+  uint16_t row;    // first row of stripe
+  uint16_t rows;   // rows of stripe
+  uint32_t bytes;  // payload bytes
+};
+static_assert(sizeof(StripeHeader) == 20, "stripe header is not packed");
+
+/**
+ * @brief: record of polygon output format, host byte order, followed by
+ *         points of int16 x, y in output image coordinates
+ */
+struct PolygonHeader {
+  uint32_t magic;
+  uint32_t frame_id;
+  uint16_t width;    // output image width
+  uint16_t height;   // output image height
+  uint16_t points;   // polygon points, 0 if no road
+  uint16_t reserved;
+  uint32_t area;     // pixels inside contour of largest road region
+};
+static_assert(sizeof(PolygonHeader) == 20, "polygon header is not packed");
+
+/**
+ * @brief: record of free space output format, host byte order, followed
+ *         by uint16 boundary per column, then uint8 confidence per column
+ *         if flagged
+ */
+struct FreeSpaceHeader {
+  uint32_t magic;
+  uint32_t frame_id;
+  uint16_t width;    // columns
+  uint16_t height;   // rows, boundary of a column without free space
+  uint16_t flags;    // kFreeSpaceConfidence
+  uint16_t reserved;
+  uint32_t bytes;    // payload bytes
+};
+static_assert(sizeof(FreeSpaceHeader) == 20,
+              "free space header is not packed");
+
+// confidence follows the boundary in a free space record
+const uint16_t kFreeSpaceConfidence = 1;
+
+/**
+ * @brief: record of bird's-eye-view output format, host byte order,
+ *         followed by width * height 8-bit road levels, row by row
+ */
+struct BevHeader {
+  uint32_t magic;
+  uint32_t frame_id;
+  uint16_t width;    // cells per row
+  uint16_t height;   // rows of cells
+  uint16_t reserved[2];
+  uint32_t bytes;    // payload bytes
+};
+static_assert(sizeof(BevHeader) == 20, "bev header is not packed");
+
+/**
+ * @brief: what GeneralPost sends per frame
+ */
+enum OutputFormat {
+  kOutputOverlay = 0,  // overlay image, whole or in stripes
+  kOutputPolygon = 1,  // outline polygon of largest road region
+  kOutputFreeSpace = 2, // top row of free road per column
+  kOutputBev = 3        // road mask projected to a top-down grid
+};
+
+/**
+ * @brief: image buffers of GeneralPost, sized at Init from the configured
+ *         shapes and reused every frame; a buffer is only reallocated when
+ *         its shape changes
+ */
+class PostWorkspace {
+public:
+  PostWorkspace();
+
+  /**
+   * @brief: allocate all buffers
+   * @param [in]: frame_width: camera frame width
+   * @param [in]: frame_height: camera frame height
+   * @param [in]: image_width: output image width
+   * @param [in]: image_height: output image height
+   * @param [in]: workers: threads, each has own scratch
+   * @return: true: success; false: failed
+   */
+  bool Reserve(int32_t frame_width, int32_t frame_height,
+               int32_t image_width, int32_t image_height, uint32_t workers);
+
+  /**
+   * @brief: RGB/BGR frame buffer of given size
+   */
+  cv::Mat &Frame(int32_t width, int32_t height);
+
+  /**
+   * @brief: output image buffer, 3 channels
+   */
+  cv::Mat &Image() {
+    return image_;
+  }
+
+  /**
+   * @brief: binary road mask of output size, 1 channel
+   */
+  cv::Mat &RoadMask() {
+    return road_mask_;
+  }
+
+  /**
+   * @brief: mask upsampled from lower resolution models
+   */
+  Tensor<float, 3> &Mask() {
+    return mask_;
+  }
+
+  /**
+   * @brief: overlay row scratch of a worker
+   */
+  uint8_t *Scratch(uint32_t worker) {
+    return &scratch_[worker * scratch_stride_];
+  }
+
+  /**
+   * @brief: bytes held now
+   */
+  size_t Bytes() const;
+
+  /**
+   * @brief: bytes, high-water mark and reallocations
+   */
+  std::string ToString() const;
+
+  /**
+   * @brief: grow per worker scratch to at least bytes
+   */
+  void ReserveScratch(uint32_t bytes);
+
+  /**
+   * @brief: update high-water mark after a buffer changed
+   */
+  void Track();
+
+private:
+  cv::Mat frame_;
+  cv::Mat image_;
+  cv::Mat road_mask_;
+  Tensor<float, 3> mask_;
+  std::vector<uint8_t> scratch_;
+  uint32_t scratch_stride_;
+  uint32_t workers_;
+  size_t high_water_;
+  uint64_t reallocations_;
 };
 
 /**
@@ -137,6 +506,150 @@ private:
    */
   bool SendSentinel();
 
+  /**
+   * @brief: check inference output and view it in output shape (HWC),
+   *         no copy; lower resolution masks are upsampled into workspace.
+   *         Mask statistics are updated from the view when enabled
+   * @param [in]: result: engine transform image
+   * @param [out]: output: view of output shape
+   * @return: true: success; false: failed
+   */
+  bool ArrangeOutput(const std::shared_ptr<EngineTrans> &result,
+                     TensorView<const float> &output);
+
+  /**
+   * @brief: size every buffer for an output shape, nothing is done when
+   *         the shape is unchanged
+   * @param [in]: width: output width
+   * @param [in]: height: output height
+   * @return: true: success; false: failed
+   */
+  bool Reshape(int32_t width, int32_t height);
+
+  /**
+   * @brief: pack road mask of frame, add its area and IoU with the mask
+   *         of previous frame to statistics
+   * @param [in]: output: output tensor view, HWC
+   */
+  void UpdateMaskStats(const TensorView<const float> &output);
+
+  /**
+   * @brief: floats of one output channel plane
+   */
+  uint32_t OutputPlane() const;
+
+  /**
+   * @brief: channel 0 of first pixel of an output row, NHWC or NCHW
+   */
+  const float *ProbRow(const TensorView<const float> &output,
+                       uint32_t row) const;
+
+  /**
+   * @brief: floats between pixels of channel 0
+   */
+  uint32_t ProbStride() const;
+
+  /**
+   * @brief: argmax class of each pixel of an output row
+   * @param [in]: output: output tensor view
+   * @param [in]: row: output row
+   * @param [out]: index: class of each pixel
+   * @param [in]: scratch: channels * width floats for NHWC
+   */
+  void ClassRow(const TensorView<const float> &output, uint32_t row,
+                uint8_t *index, uint8_t *scratch) const;
+
+  /**
+   * @brief: render output rows [begin, end) in bands on the worker pool,
+   *         converting the road region of frame first if given
+   * @param [in]: output: output tensor view, HWC
+   * @param [in]: frame: NV21 camera frame, nullptr if image is filled
+   * @param [in]: image: output size image, blended in place
+   * @param [in]: bgr: image is BGR, else RGB
+   * @param [in]: begin: first row
+   * @param [in]: end: row after last
+   */
+  void RenderRows(const TensorView<const float> &output,
+                  const ImageInfo *frame, cv::Mat &image, bool bgr,
+                  uint32_t begin, uint32_t end);
+
+  /**
+   * @brief: convert camera frame rows [begin, end) at full resolution and
+   *         blend the mask upsampled 2x onto the rows in the road region,
+   *         in bands on the worker pool
+   * @param [in]: output: output tensor view, HWC
+   * @param [in]: frame: NV21 camera frame
+   * @param [in]: image: RGB image of frame size
+   * @param [in]: begin: first row
+   * @param [in]: end: row after last
+   */
+  void RenderFullRows(const TensorView<const float> &output,
+                      const ImageInfo &frame, cv::Mat &image, uint32_t begin,
+                      uint32_t end);
+
+  /**
+   * @brief: update the stabilizer with all output rows on the worker pool,
+   *         for renders that read mask rows more than once
+   * @param [in]: output: output tensor view, HWC
+   */
+  void StabilizeMask(const TensorView<const float> &output);
+
+  /**
+   * @brief: renders rows [begin, end) of the image being sent
+   */
+  typedef std::function<void(uint32_t begin, uint32_t end)> RenderFunc;
+
+  /**
+   * @brief: render and send image, whole or stripe by stripe so the send
+   *         of a stripe overlaps rendering of the next
+   * @param [in]: image: image to send, continuous
+   * @param [in]: flags: kFrameBgr for BGR pixels
+   * @param [in]: render: fills rows of image before they are sent
+   */
+  void SendImage(cv::Mat &image, uint16_t flags, const RenderFunc &render);
+
+  /**
+   * @brief: threshold road probability into a binary mask on the worker
+   *         pool, the stabilizer's mask when it is enabled
+   * @param [in]: output: output tensor view, HWC
+   * @param [out]: mask: 8-bit mask of output size, 0 or 255
+   */
+  void BuildRoadMask(const TensorView<const float> &output, cv::Mat &mask);
+
+  /**
+   * @brief: send payload parts as one frame of the current result
+   * @param [in]: encoding: FrameEncoding of payload
+   * @param [in]: flags: frame flags
+   * @param [in]: width: width of image, mask or grid
+   * @param [in]: height: height of image, mask or grid
+   * @param [in]: parts: payload parts
+   * @param [in]: count: payload parts
+   * @return: true: queued to the sender; false: dropped
+   */
+  bool SendFrame(uint16_t encoding, uint16_t flags, uint32_t width,
+                 uint32_t height, const struct iovec *parts, int count);
+
+  /**
+   * @brief: send one record as a frame
+   */
+  bool SendRecord(uint16_t encoding, uint32_t width, uint32_t height) {
+    struct iovec part = { record_.data(), record_.size() };
+    return SendFrame(encoding, 0, width, height, &part, 1);
+  }
+
+  /**
+   * @brief: subscription of the viewer as the sender thread last read it
+   * @return: true: a connected viewer wants the overlay
+   */
+  bool OverlayWanted();
+
+  /**
+   * @brief: frame without overlay: keep mask state of the stabilizer
+   * @param [in]: result: engine transform image
+   * @return: HIAI_StatusT
+   */
+  HIAI_StatusT ModelPostProcessSkip(const std::shared_ptr<EngineTrans> &result);
+
   /**
    * @brief: mark the oject based on segmentation result (cap)
    * @param [in]: result: engine transform image
@@ -151,10 +664,107 @@ private:
    */
   HIAI_StatusT ModelPostProcessPic(const std::shared_ptr<EngineTrans> &result);
 
+  /**
+   * @brief: send outline polygon of largest road region instead of image
+   * @param [in]: result: engine transform image
+   * @return: HIAI_StatusT
+   */
+  HIAI_StatusT ModelPostProcessPolygon(
+      const std::shared_ptr<EngineTrans> &result);
+
+  /**
+   * @brief: send free space boundary per column instead of image
+   * @param [in]: result: engine transform image
+   * @return: HIAI_StatusT
+   */
+  HIAI_StatusT ModelPostProcessFreeSpace(
+      const std::shared_ptr<EngineTrans> &result);
+
+  /**
+   * @brief: send road mask projected to bird's-eye view instead of image
+   * @param [in]: result: engine transform image
+   * @return: HIAI_StatusT
+   */
+  HIAI_StatusT ModelPostProcessBev(const std::shared_ptr<EngineTrans> &result);
+
 private:
-  int sokt;
   struct sockaddr_in serverAddr;
-  socklen_t addrLen;
+  // sender thread of the framed viewer connection
+  std::unique_ptr<FrameSender> sender_;
+  // capture time of the result being sent
+  int64_t timestamp_us_;
+
+  // output shape, of the full resolution model once results arrive
+  int32_t output_width_;
+  int32_t output_height_;
+  int32_t camera_width_;
+  int32_t camera_height_;
+
+  // overlay only after the viewer asked for it, else while connected
+  bool overlay_on_demand_;
+  uint64_t overlay_rendered_;
+  uint64_t overlay_skipped_;
+
+  // overlay on the whole camera frame instead of the road region
+  bool full_overlay_;
+
+  // multi-class output, argmax class map colourized by palette
+  bool class_overlay_;
+  // output tensor is NCHW, else NHWC
+  bool planar_output_;
+  // channels of current output tensor
+  uint32_t channels_;
+  classmap::Palette palette_rgb_;
+  classmap::Palette palette_bgr_;
+
+  // rows per stripe, 0 sends whole frames without header
+  uint32_t stripe_rows_;
+  uint32_t frame_id_;
+
+  OutputFormat output_format_;
+  // road probability of polygon, free space and mask statistics
+  float road_threshold_;
+  uint8_t road_level_;
+  // max distance of contour from polygon, output pixels
+  double polygon_epsilon_;
+  // contour and record buffers reused across frames
+  std::vector<std::vector<cv::Point> > contours_;
+  std::vector<cv::Point> polygon_;
+  // send lowest probability of each free run too
+  bool freespace_confidence_;
+  std::vector<uint16_t> boundary_;
+  std::vector<uint8_t> confidence_;
+  // bird's-eye-view grid, taps built at Init and padded mask
+  uint32_t bev_width_;
+  uint32_t bev_height_;
+  double bev_matrix_[9];
+  std::vector<uint32_t> bev_table_;
+  std::vector<uint8_t> bev_mask_;
+  std::vector<uint8_t> record_;
+
+  // temporal filter of road mask, null if disabled
+  std::unique_ptr<MaskStabilizer> stabilizer_;
+
+  // row band workers of per-pixel kernels
+  std::unique_ptr<WorkerPool> pool_;
+
+  // buffers reused across frames
+  PostWorkspace workspace_;
+
+  // road area and frame to frame IoU statistics of packed masks
+  bool mask_stats_;
+  packedmask::PackedMask road_mask_;
+  packedmask::PackedMask previous_road_mask_;
+  uint64_t mask_stats_frames_;
+  double mask_area_total_;
+  double mask_iou_total_;
+
+  // frames through post, paces the periodic report
+  uint64_t post_frames_;
+
+  // capture to post latency statistics, frames stamped at capture only
+  uint64_t latency_frames_;
+  double latency_total_ms_;
 
 };
 
@@ -0,0 +1,171 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "mask_stabilizer.h"
+
+#include <cmath>
+#include <sstream>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define STABILIZER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STABILIZER_SSE2 1
+#endif
+
+namespace {
+/**
+ * @brief: average' = average * (256 - a) / 256 + q * a, per pixel
+ *         mask' = average' >= high || (mask && average' > low)
+ */
+void StabilizeRow(uint8_t *q, uint16_t *average, uint8_t *mask,
+                  uint32_t width, uint16_t alpha, uint8_t low, uint8_t high) {
+  uint32_t x = 0;
+  // both products as high halves of 16x16 multiplies
+  uint16_t keep_weight = (256 - alpha) << 8;
+  uint16_t new_weight = alpha << 8;
+#if defined(STABILIZER_NEON)
+  uint16x4_t keep_v = vdup_n_u16(keep_weight);
+  uint16x4_t new_v = vdup_n_u16(new_weight);
+  uint16x8_t high_v = vdupq_n_u16(high);
+  uint16x8_t low_v = vdupq_n_u16(low);
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t value = vshlq_n_u16(vmovl_u8(vld1_u8(q + x)), 8);
+    uint16x8_t avg = vld1q_u16(average + x);
+    uint16x4_t lo = vadd_u16(
+        vshrn_n_u32(vmull_u16(vget_low_u16(avg), keep_v), 16),
+        vshrn_n_u32(vmull_u16(vget_low_u16(value), new_v), 16));
+    uint16x4_t hi = vadd_u16(
+        vshrn_n_u32(vmull_u16(vget_high_u16(avg), keep_v), 16),
+        vshrn_n_u32(vmull_u16(vget_high_u16(value), new_v), 16));
+    avg = vcombine_u16(lo, hi);
+    vst1q_u16(average + x, avg);
+    uint16x8_t level = vshrq_n_u16(avg, 8);
+    uint16x8_t on = vcgeq_u16(level, high_v);
+    uint16x8_t keep = vandq_u16(vcgtq_u16(level, low_v),
+                                vtstq_u16(vmovl_u8(vld1_u8(mask + x)),
+                                          vdupq_n_u16(0xFF)));
+    uint8x8_t stable = vmovn_u16(vorrq_u16(on, keep));
+    vst1_u8(mask + x, stable);
+    vst1_u8(q + x, stable);
+  }
+#elif defined(STABILIZER_SSE2)
+  __m128i keep_v = _mm_set1_epi16(static_cast<int16_t>(keep_weight));
+  __m128i new_v = _mm_set1_epi16(static_cast<int16_t>(new_weight));
+  // levels are below 256, signed compares are safe
+  __m128i high_v = _mm_set1_epi16(static_cast<int16_t>(high) - 1);
+  __m128i low_v = _mm_set1_epi16(low);
+  __m128i zero = _mm_setzero_si128();
+  for (; x + 8 <= width; x += 8) {
+    __m128i value = _mm_slli_epi16(_mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(q + x)), zero), 8);
+    __m128i avg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+        average + x));
+    avg = _mm_add_epi16(_mm_mulhi_epu16(avg, keep_v),
+                        _mm_mulhi_epu16(value, new_v));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(average + x), avg);
+    __m128i level = _mm_srli_epi16(avg, 8);
+    __m128i on = _mm_cmpgt_epi16(level, high_v);
+    __m128i was_on = _mm_cmpgt_epi16(_mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mask + x)), zero),
+        zero);
+    __m128i keep = _mm_and_si128(_mm_cmpgt_epi16(level, low_v), was_on);
+    __m128i stable = _mm_srli_epi16(_mm_or_si128(on, keep), 8);
+    stable = _mm_packus_epi16(stable, stable);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(mask + x), stable);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(q + x), stable);
+  }
+#endif
+  for (; x < width; x++) {
+    uint32_t avg = ((average[x] * static_cast<uint32_t>(keep_weight)) >> 16)
+        + ((static_cast<uint32_t>(q[x]) << 8) * new_weight >> 16);
+    average[x] = static_cast<uint16_t>(avg);
+    uint32_t level = avg >> 8;
+    bool on = level >= high || (mask[x] != 0 && level > low);
+    mask[x] = on ? 255 : 0;
+    q[x] = mask[x];
+  }
+}
+}
+
+MaskStabilizer::MaskStabilizer(float alpha, uint8_t low, uint8_t high)
+    : low_(low),
+      high_(high),
+      width_(0),
+      height_(0),
+      primed_(false),
+      frames_(0) {
+  // 256 would overflow the 16-bit weight, 255 is as good as no averaging
+  long weight = lround(alpha * 256.0f);
+  alpha_ = static_cast<uint16_t>(weight < 1 ? 1 : (weight > 255 ? 255
+      : weight));
+}
+
+void MaskStabilizer::Reset(uint32_t width, uint32_t height) {
+  if (width == width_ && height == height_) {
+    return;
+  }
+  width_ = width;
+  height_ = height;
+  primed_ = false;
+  average_.assign(width * height, 0);
+  mask_.assign(width * height, 0);
+}
+
+void MaskStabilizer::UpdateRow(uint32_t row, uint8_t *q) {
+  uint16_t *average = &average_[row * width_];
+  uint8_t *mask = &mask_[row * width_];
+  if (!primed_) {
+    // first frame is the average, thresholded at high
+    for (uint32_t x = 0; x < width_; x++) {
+      average[x] = static_cast<uint16_t>(q[x] << 8);
+      mask[x] = q[x] >= high_ ? 255 : 0;
+      q[x] = mask[x];
+    }
+    return;
+  }
+  StabilizeRow(q, average, mask, width_, alpha_, low_, high_);
+}
+
+void MaskStabilizer::EndFrame() {
+  primed_ = true;
+  frames_++;
+}
+
+std::string MaskStabilizer::ToString() const {
+  std::stringstream sstream;
+  sstream << "alpha " << alpha_ << "/256, low " << (uint32_t) low_
+          << ", high " << (uint32_t) high_ << ", frames " << frames_;
+  return sstream.str();
+}
@@ -0,0 +1,107 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_MASK_STABILIZER_H_
+#define GENERAL_POST_MASK_STABILIZER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief: temporal stabilizer of the road mask. Keeps a per pixel
+ *         exponential moving average of the 8-bit probability (8.8 fixed
+ *         point) and a binary mask with hysteresis: a pixel turns on at
+ *         high and off at low. Rows are updated from the probability row
+ *         already read for the overlay, no extra pass over the tensor
+ */
+class MaskStabilizer {
+public:
+  /**
+   * @brief: constructor
+   * @param [in]: alpha: weight of new frame, (0, 1]
+   * @param [in]: low: 8-bit probability turning a pixel off
+   * @param [in]: high: 8-bit probability turning a pixel on
+   */
+  MaskStabilizer(float alpha, uint8_t low, uint8_t high);
+
+  /**
+   * @brief: size state; state restarts when the shape changes
+   * @param [in]: width: mask width
+   * @param [in]: height: mask height
+   */
+  void Reset(uint32_t width, uint32_t height);
+
+  /**
+   * @brief: update one row and replace q by the stable mask (0 or 255);
+   *         rows of a frame may be updated concurrently
+   * @param [in]: row: mask row
+   * @param [in]: q: 8-bit probability in, stable mask out
+   */
+  void UpdateRow(uint32_t row, uint8_t *q);
+
+  /**
+   * @brief: a frame was updated, next frame averages with it
+   */
+  void EndFrame();
+
+  /**
+   * @brief: stable mask row, 0 or 255
+   */
+  const uint8_t *MaskRow(uint32_t row) const {
+    return &mask_[row * width_];
+  }
+
+  uint32_t Width() const {
+    return width_;
+  }
+
+  uint32_t Height() const {
+    return height_;
+  }
+
+  std::string ToString() const;
+
+private:
+  uint16_t alpha_;  // weight of new frame of 256
+  uint8_t low_;
+  uint8_t high_;
+  uint32_t width_;
+  uint32_t height_;
+  bool primed_;     // average holds a frame
+  uint64_t frames_;
+  std::vector<uint16_t> average_;
+  std::vector<uint8_t> mask_;
+};
+
+#endif /* GENERAL_POST_MASK_STABILIZER_H_ */
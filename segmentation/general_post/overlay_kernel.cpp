@@ -0,0 +1,557 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "overlay_kernel.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OVERLAY_KERNEL_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define OVERLAY_KERNEL_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OVERLAY_KERNEL_SSE2 1
+#endif
+
+namespace overlay {
+
+namespace {
+// rounding of the >> 8
+const uint32_t kRound = 128;
+
+inline uint8_t ToFixed(float value) {
+  value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<uint8_t>(static_cast<int32_t>(value * 255.0f + 0.5f));
+}
+
+inline uint8_t Blend(uint32_t mask, uint32_t image) {
+  return static_cast<uint8_t>((kMaskWeight * mask + kImageWeight * image
+      + kRound) >> 8);
+}
+
+#if defined(OVERLAY_KERNEL_SSE2) || defined(OVERLAY_KERNEL_AVX2)
+// byte k of an interleaved row is channel k % 3: the mask byte is q on
+// channel 0 and 255 - q = q ^ 0xFF on channel 2, channel 1 keeps the
+// image. Two 48-byte periods cover a 96-byte AVX2 step, SSE2 uses 48
+alignas(32) const uint8_t kGreenBytes[96] = {
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00,
+    0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00
+};
+#endif
+
+#if defined(OVERLAY_KERNEL_AVX2)
+alignas(32) const uint8_t kInvertBytes[96] = {
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF
+};
+
+// mask byte k takes q of pixel k / 3, from the 16 q held by its lane
+alignas(32) const uint8_t kSpreadIndex[96] = {
+    0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5,
+    5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10,
+    10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15,
+    0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5,
+    5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10,
+    10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15
+};
+
+inline __m256i Mix(__m256i mask, __m256i image, __m256i mask_weight,
+                   __m256i image_weight, __m256i round) {
+  __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(mask, mask_weight),
+                                 _mm256_mullo_epi16(image, image_weight));
+  // max 255 * 256 + 128 fits unsigned 16-bit, logical shift
+  return _mm256_srli_epi16(_mm256_add_epi16(sum, round), 8);
+}
+#elif defined(OVERLAY_KERNEL_SSE2)
+alignas(16) const uint16_t kInvertWords[24] = {
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+    0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF
+};
+
+/**
+ * @brief: 8 q words to the 24 mask words of their pixels, channel 2
+ *         inverted; SSE2 has no byte shuffle, words are repeated by the
+ *         immediate dword and word shuffles
+ */
+inline void SpreadWords(__m128i q, const __m128i *invert, __m128i *mask) {
+  // q0 q0 q0 q1 q1 q1 q2 q2
+  __m128i a = _mm_shuffle_epi32(q, _MM_SHUFFLE(1, 0, 0, 0));
+  a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(1, 0, 0, 0));
+  mask[0] = _mm_xor_si128(_mm_shufflehi_epi16(a, _MM_SHUFFLE(2, 2, 1, 1)),
+                          invert[0]);
+  // q2 q3 q3 q3 q4 q4 q4 q5
+  __m128i b = _mm_shuffle_epi32(q, _MM_SHUFFLE(2, 2, 1, 1));
+  b = _mm_shufflelo_epi16(b, _MM_SHUFFLE(1, 1, 1, 0));
+  mask[1] = _mm_xor_si128(_mm_shufflehi_epi16(b, _MM_SHUFFLE(1, 0, 0, 0)),
+                          invert[1]);
+  // q5 q5 q6 q6 q6 q7 q7 q7
+  __m128i c = _mm_shuffle_epi32(q, _MM_SHUFFLE(3, 3, 3, 2));
+  c = _mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 1, 1));
+  mask[2] = _mm_xor_si128(_mm_shufflehi_epi16(c, _MM_SHUFFLE(1, 1, 1, 0)),
+                          invert[2]);
+}
+
+inline __m128i Mix(__m128i mask, __m128i image, __m128i mask_weight,
+                   __m128i image_weight, __m128i round) {
+  __m128i sum = _mm_add_epi16(_mm_mullo_epi16(mask, mask_weight),
+                              _mm_mullo_epi16(image, image_weight));
+  // max 255 * 256 + 128 fits unsigned 16-bit, logical shift
+  return _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+}
+#endif
+}
+
+namespace {
+/**
+ * @brief: vector part of the conversion for a fixed channel count,
+ *         returns pixels done; counts without a vector path do none
+ */
+template <uint32_t kStride>
+struct FixedConverter {
+  static uint32_t Vector(const float *, uint8_t *, uint32_t) {
+    return 0;
+  }
+};
+
+// planar tensor, probabilities are contiguous
+template <>
+struct FixedConverter<1> {
+  static uint32_t Vector(const float *prob, uint8_t *q, uint32_t width) {
+    uint32_t x = 0;
+#if defined(OVERLAY_KERNEL_NEON)
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t scale = vdupq_n_f32(255.0f);
+    float32x4_t half = vdupq_n_f32(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      float32x4_t v0 = vminq_f32(vmaxq_f32(vld1q_f32(prob + x), zero), one);
+      float32x4_t v1 = vminq_f32(vmaxq_f32(vld1q_f32(prob + x + 4), zero),
+                                 one);
+      uint32x4_t i0 = vcvtq_u32_f32(vmlaq_f32(half, v0, scale));
+      uint32x4_t i1 = vcvtq_u32_f32(vmlaq_f32(half, v1, scale));
+      uint16x8_t i16 = vcombine_u16(vmovn_u32(i0), vmovn_u32(i1));
+      vst1_u8(q + x, vmovn_u16(i16));
+    }
+#elif defined(OVERLAY_KERNEL_AVX2)
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 scale = _mm256_set1_ps(255.0f);
+    __m256 half = _mm256_set1_ps(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(prob + x), zero),
+                               one);
+      __m256i i32 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale),
+                                                      half));
+      __m128i i16 = _mm_packs_epi32(_mm256_castsi256_si128(i32),
+                                    _mm256_extracti128_si256(i32, 1));
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(q + x),
+                       _mm_packus_epi16(i16, i16));
+    }
+#elif defined(OVERLAY_KERNEL_SSE2)
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      __m128 p0 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(prob + x), zero), one);
+      __m128 p1 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(prob + x + 4), zero),
+                             one);
+      __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(p0, scale), half));
+      __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(p1, scale), half));
+      __m128i i16 = _mm_packs_epi32(i0, i1);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(q + x),
+                       _mm_packus_epi16(i16, i16));
+    }
+#endif
+    return x;
+  }
+};
+
+// interleaved two-class tensor, road probability at even floats
+template <>
+struct FixedConverter<2> {
+  static uint32_t Vector(const float *prob, uint8_t *q, uint32_t width) {
+    uint32_t x = 0;
+#if defined(OVERLAY_KERNEL_NEON)
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t scale = vdupq_n_f32(255.0f);
+    float32x4_t half = vdupq_n_f32(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      float32x4x2_t p0 = vld2q_f32(prob + x * 2);
+      float32x4x2_t p1 = vld2q_f32(prob + x * 2 + 8);
+      float32x4_t v0 = vminq_f32(vmaxq_f32(p0.val[0], zero), one);
+      float32x4_t v1 = vminq_f32(vmaxq_f32(p1.val[0], zero), one);
+      uint32x4_t i0 = vcvtq_u32_f32(vmlaq_f32(half, v0, scale));
+      uint32x4_t i1 = vcvtq_u32_f32(vmlaq_f32(half, v1, scale));
+      uint16x8_t i16 = vcombine_u16(vmovn_u32(i0), vmovn_u32(i1));
+      vst1_u8(q + x, vmovn_u16(i16));
+    }
+#elif defined(OVERLAY_KERNEL_AVX2)
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 scale = _mm256_set1_ps(255.0f);
+    __m256 half = _mm256_set1_ps(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      __m256 a = _mm256_loadu_ps(prob + x * 2);
+      __m256 b = _mm256_loadu_ps(prob + x * 2 + 8);
+      // even elements of a and b, lanes reordered back by permute
+      __m256 even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even),
+                                                    _MM_SHUFFLE(3, 1, 2, 0)));
+      even = _mm256_min_ps(_mm256_max_ps(even, zero), one);
+      __m256i i32 = _mm256_cvttps_epi32(_mm256_add_ps(
+          _mm256_mul_ps(even, scale), half));
+      __m128i i16 = _mm_packs_epi32(_mm256_castsi256_si128(i32),
+                                    _mm256_extracti128_si256(i32, 1));
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(q + x),
+                       _mm_packus_epi16(i16, i16));
+    }
+#elif defined(OVERLAY_KERNEL_SSE2)
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    for (; x + 8 <= width; x += 8) {
+      __m128 p0 = _mm_shuffle_ps(_mm_loadu_ps(prob + x * 2),
+                                 _mm_loadu_ps(prob + x * 2 + 4),
+                                 _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 p1 = _mm_shuffle_ps(_mm_loadu_ps(prob + x * 2 + 8),
+                                 _mm_loadu_ps(prob + x * 2 + 12),
+                                 _MM_SHUFFLE(2, 0, 2, 0));
+      p0 = _mm_min_ps(_mm_max_ps(p0, zero), one);
+      p1 = _mm_min_ps(_mm_max_ps(p1, zero), one);
+      __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(p0, scale), half));
+      __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(p1, scale), half));
+      __m128i i16 = _mm_packs_epi32(i0, i1);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(q + x),
+                       _mm_packus_epi16(i16, i16));
+    }
+#endif
+    return x;
+  }
+};
+
+template <uint32_t kStride>
+void FixedRow(const float *prob, uint8_t *q, uint32_t width) {
+  uint32_t x = FixedConverter<kStride>::Vector(prob, q, width);
+  for (; x < width; x++) {
+    q[x] = ToFixed(prob[x * kStride]);
+  }
+}
+}
+
+void ProbabilityToFixed(const float *prob, uint32_t prob_stride, uint8_t *q,
+                        uint32_t width) {
+  // shapes the models produce get a fixed stride, others the generic loop
+  switch (prob_stride) {
+    case 1:
+      FixedRow<1>(prob, q, width);
+      break;
+    case 2:
+      FixedRow<2>(prob, q, width);
+      break;
+    default:
+      for (uint32_t x = 0; x < width; x++) {
+        q[x] = ToFixed(prob[x * prob_stride]);
+      }
+      break;
+  }
+}
+
+void BlendFixedRow(const uint8_t *q, const uint8_t *src, uint8_t *dst,
+                   uint32_t width) {
+  uint32_t x = 0;
+#if defined(OVERLAY_KERNEL_NEON)
+  uint8x8_t mask_weight = vdup_n_u8(kMaskWeight);
+  uint8x8_t image_weight = vdup_n_u8(kImageWeight);
+  uint8x16_t full = vdupq_n_u8(255);
+  for (; x + 16 <= width; x += 16) {
+    uint8x16_t qv = vld1q_u8(q + x);
+    uint8x16x3_t pixel = vld3q_u8(src + x * 3);
+    uint8x16_t inverse = vsubq_u8(full, qv);
+    // channel 0
+    uint16x8_t lo = vmull_u8(vget_low_u8(qv), mask_weight);
+    lo = vmlal_u8(lo, vget_low_u8(pixel.val[0]), image_weight);
+    uint16x8_t hi = vmull_u8(vget_high_u8(qv), mask_weight);
+    hi = vmlal_u8(hi, vget_high_u8(pixel.val[0]), image_weight);
+    pixel.val[0] = vcombine_u8(vqrshrn_n_u16(lo, 8), vqrshrn_n_u16(hi, 8));
+    // channel 2
+    lo = vmull_u8(vget_low_u8(inverse), mask_weight);
+    lo = vmlal_u8(lo, vget_low_u8(pixel.val[2]), image_weight);
+    hi = vmull_u8(vget_high_u8(inverse), mask_weight);
+    hi = vmlal_u8(hi, vget_high_u8(pixel.val[2]), image_weight);
+    pixel.val[2] = vcombine_u8(vqrshrn_n_u16(lo, 8), vqrshrn_n_u16(hi, 8));
+    vst3q_u8(dst + x * 3, pixel);
+  }
+#elif defined(OVERLAY_KERNEL_AVX2)
+  __m256i zero = _mm256_setzero_si256();
+  __m256i mask_weight = _mm256_set1_epi16(kMaskWeight);
+  __m256i image_weight = _mm256_set1_epi16(kImageWeight);
+  __m256i round = _mm256_set1_epi16(kRound);
+  __m256i index[3];
+  __m256i invert[3];
+  __m256i green[3];
+  for (uint32_t part = 0; part < 3; part++) {
+    index[part] = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(kSpreadIndex + part * 32));
+    invert[part] = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(kInvertBytes + part * 32));
+    green[part] = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(kGreenBytes + part * 32));
+  }
+  // 32 pixels, 96 bytes per step; vpshufb picks within a lane, so each
+  // lane of the source holds the 16 q its mask bytes need
+  for (; x + 32 <= width; x += 32) {
+    __m128i qa = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + x));
+    __m128i qb = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(q + x + 16));
+    __m256i source[3];
+    source[0] = _mm256_broadcastsi128_si256(qa);
+    source[1] = _mm256_inserti128_si256(_mm256_castsi128_si256(qa), qb, 1);
+    source[2] = _mm256_broadcastsi128_si256(qb);
+    for (uint32_t part = 0; part < 3; part++) {
+      __m256i mask = _mm256_xor_si256(
+          _mm256_shuffle_epi8(source[part], index[part]), invert[part]);
+      __m256i image = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(src + x * 3 + part * 32));
+      // unpack and pack both stay in lane, byte order is kept
+      __m256i lo = Mix(_mm256_unpacklo_epi8(mask, zero),
+                       _mm256_unpacklo_epi8(image, zero), mask_weight,
+                       image_weight, round);
+      __m256i hi = Mix(_mm256_unpackhi_epi8(mask, zero),
+                       _mm256_unpackhi_epi8(image, zero), mask_weight,
+                       image_weight, round);
+      __m256i out = _mm256_blendv_epi8(_mm256_packus_epi16(lo, hi), image,
+                                       green[part]);
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i *>(dst + x * 3 + part * 32), out);
+    }
+  }
+#elif defined(OVERLAY_KERNEL_SSE2)
+  __m128i zero = _mm_setzero_si128();
+  __m128i mask_weight = _mm_set1_epi16(kMaskWeight);
+  __m128i image_weight = _mm_set1_epi16(kImageWeight);
+  __m128i round = _mm_set1_epi16(kRound);
+  __m128i invert[3];
+  __m128i green[3];
+  for (uint32_t part = 0; part < 3; part++) {
+    invert[part] = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(kInvertWords + part * 8));
+    green[part] = _mm_load_si128(
+        reinterpret_cast<const __m128i *>(kGreenBytes + part * 16));
+  }
+  // 16 pixels, 48 bytes per step, the mask never leaves registers
+  for (; x + 16 <= width; x += 16) {
+    __m128i qv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + x));
+    __m128i mask[6];
+    SpreadWords(_mm_unpacklo_epi8(qv, zero), invert, mask);
+    SpreadWords(_mm_unpackhi_epi8(qv, zero), invert, mask + 3);
+    for (uint32_t part = 0; part < 3; part++) {
+      __m128i image = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(src + x * 3 + part * 16));
+      __m128i lo = Mix(mask[part * 2], _mm_unpacklo_epi8(image, zero),
+                       mask_weight, image_weight, round);
+      __m128i hi = Mix(mask[part * 2 + 1], _mm_unpackhi_epi8(image, zero),
+                       mask_weight, image_weight, round);
+      // channel 1 keeps the image byte
+      __m128i out = _mm_packus_epi16(lo, hi);
+      out = _mm_or_si128(_mm_and_si128(green[part], image),
+                         _mm_andnot_si128(green[part], out));
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i *>(dst + x * 3 + part * 16), out);
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    const uint8_t *pixel = src + x * 3;
+    uint8_t *out = dst + x * 3;
+    out[0] = Blend(q[x], pixel[0]);
+    out[1] = pixel[1];
+    out[2] = Blend(255 - q[x], pixel[2]);
+  }
+}
+
+void BlendRow(const float *prob, uint32_t prob_stride, const uint8_t *src,
+              uint8_t *dst, uint32_t width, uint8_t *scratch) {
+  uint8_t *q = scratch;
+  ProbabilityToFixed(prob, prob_stride, q, width);
+  BlendFixedRow(q, src, dst, width);
+}
+
+void UpsampleRow2x(const uint8_t *near, const uint8_t *far, uint8_t *out,
+                   uint32_t width, uint16_t *scratch) {
+  // vertical pass, 4x scaled, padded by one replicated value each side
+  uint16_t *column = scratch + 1;
+  uint32_t x = 0;
+#if defined(OVERLAY_KERNEL_NEON)
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t n = vmovl_u8(vld1_u8(near + x));
+    uint16x8_t f = vmovl_u8(vld1_u8(far + x));
+    vst1q_u16(column + x, vmlaq_n_u16(f, n, 3));
+  }
+#elif defined(OVERLAY_KERNEL_AVX2)
+  for (; x + 16 <= width; x += 16) {
+    __m256i n = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(near + x)));
+    __m256i f = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(far + x)));
+    __m256i n3 = _mm256_add_epi16(n, _mm256_slli_epi16(n, 1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(column + x),
+                        _mm256_add_epi16(n3, f));
+  }
+#elif defined(OVERLAY_KERNEL_SSE2)
+  __m128i zero = _mm_setzero_si128();
+  for (; x + 8 <= width; x += 8) {
+    __m128i n = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(near + x)), zero);
+    __m128i f = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(far + x)), zero);
+    __m128i n3 = _mm_add_epi16(n, _mm_slli_epi16(n, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(column + x),
+                     _mm_add_epi16(n3, f));
+  }
+#endif
+  for (; x < width; x++) {
+    column[x] = 3 * near[x] + far[x];
+  }
+  column[-1] = column[0];
+  column[width] = column[width - 1];
+
+  // horizontal pass, even outputs lean left, odd outputs lean right
+  x = 0;
+#if defined(OVERLAY_KERNEL_NEON)
+  uint16x8_t round = vdupq_n_u16(8);
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t centre = vmulq_n_u16(vld1q_u16(column + x), 3);
+    uint16x8_t left = vld1q_u16(column + x - 1);
+    uint16x8_t right = vld1q_u16(column + x + 1);
+    uint8x8x2_t pair;
+    pair.val[0] = vmovn_u16(vshrq_n_u16(
+        vaddq_u16(vaddq_u16(centre, left), round), 4));
+    pair.val[1] = vmovn_u16(vshrq_n_u16(
+        vaddq_u16(vaddq_u16(centre, right), round), 4));
+    vst2_u8(out + x * 2, pair);
+  }
+#elif defined(OVERLAY_KERNEL_AVX2)
+  __m256i round = _mm256_set1_epi16(8);
+  for (; x + 16 <= width; x += 16) {
+    __m256i c = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(column + x));
+    __m256i centre = _mm256_add_epi16(c, _mm256_slli_epi16(c, 1));
+    __m256i left = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(column + x - 1));
+    __m256i right = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(column + x + 1));
+    __m256i even = _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(centre, left), round), 4);
+    __m256i odd = _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_add_epi16(centre, right), round), 4);
+    // shifts stay inside 16-bit elements, no lane crossing needed
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + x * 2),
+                        _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)));
+  }
+#elif defined(OVERLAY_KERNEL_SSE2)
+  __m128i round = _mm_set1_epi16(8);
+  for (; x + 8 <= width; x += 8) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(column + x));
+    __m128i centre = _mm_add_epi16(c, _mm_slli_epi16(c, 1));
+    __m128i left = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(column + x - 1));
+    __m128i right = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(column + x + 1));
+    __m128i even = _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(centre, left), round), 4);
+    __m128i odd = _mm_srli_epi16(
+        _mm_add_epi16(_mm_add_epi16(centre, right), round), 4);
+    // 8-bit values in low bytes, odd shifted to high bytes interleaves
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 2),
+                     _mm_or_si128(even, _mm_slli_epi16(odd, 8)));
+  }
+#endif
+  for (; x < width; x++) {
+    const uint16_t *value = column + x;
+    uint32_t centre = 3 * value[0];
+    out[x * 2] = static_cast<uint8_t>((centre + value[-1] + 8) >> 4);
+    out[x * 2 + 1] = static_cast<uint8_t>((centre + value[1] + 8) >> 4);
+  }
+}
+
+void BlendUpsampledRow(const float *near, const float *far,
+                       uint32_t prob_stride, uint8_t *row, uint32_t width,
+                       uint8_t *scratch) {
+  uint8_t *q_near = scratch;
+  uint8_t *q_far = q_near + width;
+  uint8_t *q = q_far + width;
+  uint16_t *column = reinterpret_cast<uint16_t *>(q + width * 2);
+  ProbabilityToFixed(near, prob_stride, q_near, width);
+  ProbabilityToFixed(far, prob_stride, q_far, width);
+  UpsampleRow2x(q_near, q_far, q, width, column);
+  BlendFixedRow(q, row, row, width * 2);
+}
+
+void BlendRowReference(const float *prob, uint32_t prob_stride,
+                       const uint8_t *src, uint8_t *dst, uint32_t width) {
+  for (uint32_t x = 0; x < width; x++) {
+    uint32_t q = ToFixed(prob[x * prob_stride]);
+    const uint8_t *pixel = src + x * 3;
+    uint8_t *out = dst + x * 3;
+    out[0] = Blend(q, pixel[0]);
+    out[1] = pixel[1];
+    out[2] = Blend(255 - q, pixel[2]);
+  }
+}
+
+void BlendImage(const float *prob, uint32_t prob_stride, const uint8_t *src,
+                uint32_t src_step, uint8_t *dst, uint32_t dst_step,
+                uint32_t width, uint32_t height, uint8_t *scratch) {
+  for (uint32_t y = 0; y < height; y++) {
+    BlendRow(prob + y * width * prob_stride, prob_stride, src + y * src_step,
+             dst + y * dst_step, width, scratch);
+  }
+}
+
+}  // namespace overlay
@@ -0,0 +1,143 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_OVERLAY_KERNEL_H_
+#define GENERAL_POST_OVERLAY_KERNEL_H_
+
+#include <stdint.h>
+
+/**
+ * @brief: overlay of the road probability onto a 3-channel 8-bit image.
+ *         q = probability in 8-bit fixed point, per pixel:
+ *           out[0] = (102 * q + 154 * in[0] + 128) >> 8
+ *           out[1] = in[1]
+ *           out[2] = (102 * (255 - q) + 154 * in[2] + 128) >> 8
+ *         i.e. 0.4 / 0.6 blend. SIMD versions (NEON, SSE2, AVX2) are
+ *         bit-exact with the scalar reference
+ */
+namespace overlay {
+
+// blend weights of the mask and the image, sum is 256
+const uint32_t kMaskWeight = 102;
+const uint32_t kImageWeight = 154;
+
+/**
+ * @brief: scratch bytes needed by BlendRow for a row of width pixels
+ */
+inline uint32_t ScratchSize(uint32_t width) {
+  return width + 64;
+}
+
+/**
+ * @brief: probability to 8-bit fixed point, clamped to [0, 1] first
+ * @param [in]: prob: probability of first pixel
+ * @param [in]: prob_stride: floats between pixels (channels of tensor)
+ * @param [out]: q: 8-bit probability
+ * @param [in]: width: pixels
+ */
+void ProbabilityToFixed(const float *prob, uint32_t prob_stride, uint8_t *q,
+                        uint32_t width);
+
+/**
+ * @brief: blend 8-bit probability row against an image row
+ * @param [in]: q: 8-bit probability
+ * @param [in]: src: image row, 3 channels interleaved
+ * @param [out]: dst: output row, may be the same as src
+ * @param [in]: width: pixels
+ */
+void BlendFixedRow(const uint8_t *q, const uint8_t *src, uint8_t *dst,
+                   uint32_t width);
+
+/**
+ * @brief: convert and blend one row, probability read once
+ */
+void BlendRow(const float *prob, uint32_t prob_stride, const uint8_t *src,
+              uint8_t *dst, uint32_t width, uint8_t *scratch);
+
+/**
+ * @brief: scratch bytes needed by BlendUpsampledRow for a mask row of
+ *         width pixels
+ */
+inline uint32_t UpsampleScratchSize(uint32_t width) {
+  return width * 4 + (width + 2) * 2 + 64;
+}
+
+/**
+ * @brief: bilinear 2x upsample of 8-bit probability rows with half-pixel
+ *         centres as cv::resize INTER_LINEAR: (3 * near + far) / 4
+ *         vertically, then (3 * centre + side) / 4 horizontally, rounded
+ * @param [in]: near: nearer mask row
+ * @param [in]: far: farther mask row, same as near at the borders
+ * @param [out]: out: 2 * width values
+ * @param [in]: width: mask pixels
+ * @param [in]: scratch: width + 2 values
+ */
+void UpsampleRow2x(const uint8_t *near, const uint8_t *far, uint8_t *out,
+                   uint32_t width, uint16_t *scratch);
+
+/**
+ * @brief: blend a probability row upsampled 2x against an image row
+ * @param [in]: near: probability of nearer mask row
+ * @param [in]: far: probability of farther mask row
+ * @param [in]: prob_stride: floats between pixels
+ * @param [in]: row: image row of 2 * width pixels, blended in place
+ * @param [in]: width: mask pixels
+ * @param [in]: scratch: UpsampleScratchSize(width) bytes
+ */
+void BlendUpsampledRow(const float *near, const float *far,
+                       uint32_t prob_stride, uint8_t *row, uint32_t width,
+                       uint8_t *scratch);
+
+/**
+ * @brief: scalar reference of BlendRow
+ */
+void BlendRowReference(const float *prob, uint32_t prob_stride,
+                       const uint8_t *src, uint8_t *dst, uint32_t width);
+
+/**
+ * @brief: blend whole image
+ * @param [in]: prob: probability tensor, layout HWC
+ * @param [in]: prob_stride: channels of tensor
+ * @param [in]: src: image, 3 channels interleaved
+ * @param [in]: src_step: bytes per image row
+ * @param [out]: dst: output image, may be the same as src
+ * @param [in]: dst_step: bytes per output row
+ * @param [in]: scratch: ScratchSize(width) bytes
+ */
+void BlendImage(const float *prob, uint32_t prob_stride, const uint8_t *src,
+                uint32_t src_step, uint8_t *dst, uint32_t dst_step,
+                uint32_t width, uint32_t height, uint8_t *scratch);
+
+}  // namespace overlay
+
+#endif /* GENERAL_POST_OVERLAY_KERNEL_H_ */
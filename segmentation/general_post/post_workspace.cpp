@@ -0,0 +1,113 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "general_post.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "overlay_kernel.h"
+
+using std::max;
+
+PostWorkspace::PostWorkspace()
+    : scratch_stride_(0),
+      workers_(0),
+      high_water_(0),
+      reallocations_(0) {
+}
+
+bool PostWorkspace::Reserve(int32_t frame_width, int32_t frame_height,
+                            int32_t image_width, int32_t image_height,
+                            uint32_t workers) {
+  if (frame_width <= 0 || frame_height <= 0 || image_width <= 0
+      || image_height <= 0 || workers == 0) {
+    return false;
+  }
+  frame_.create(frame_height, frame_width, CV_8UC3);
+  image_.create(image_height, image_width, CV_8UC3);
+  road_mask_.create(image_height, image_width, CV_8UC1);
+  const uint32_t shape[3] = { static_cast<uint32_t>(image_height),
+      static_cast<uint32_t>(image_width), 2 };
+  if (!mask_.Resize(shape)) {
+    return false;
+  }
+  // whole cache lines per worker
+  scratch_stride_ = max(overlay::ScratchSize(image_width),
+                        overlay::UpsampleScratchSize(image_width));
+  scratch_stride_ = (scratch_stride_ + 63) / 64 * 64;
+  workers_ = workers;
+  scratch_.resize(scratch_stride_ * workers_);
+  Track();
+  return true;
+}
+
+cv::Mat &PostWorkspace::Frame(int32_t width, int32_t height) {
+  if (frame_.cols != width || frame_.rows != height) {
+    frame_.create(height, width, CV_8UC3);
+    reallocations_++;
+    Track();
+  }
+  return frame_;
+}
+
+void PostWorkspace::ReserveScratch(uint32_t bytes) {
+  if (bytes <= scratch_stride_) {
+    return;
+  }
+  scratch_stride_ = (bytes + 63) / 64 * 64;
+  scratch_.resize(scratch_stride_ * workers_);
+  reallocations_++;
+  Track();
+}
+
+size_t PostWorkspace::Bytes() const {
+  return frame_.total() * frame_.elemSize()
+      + image_.total() * image_.elemSize()
+      + road_mask_.total() * road_mask_.elemSize()
+      + mask_.Size() * sizeof(float) + scratch_.size();
+}
+
+void PostWorkspace::Track() {
+  size_t bytes = Bytes();
+  if (bytes > high_water_) {
+    high_water_ = bytes;
+  }
+}
+
+std::string PostWorkspace::ToString() const {
+  std::stringstream sstream;
+  sstream << "bytes " << Bytes() << ", high water " << high_water_
+          << ", reallocations " << reallocations_;
+  return sstream.str();
+}
@@ -0,0 +1,171 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#include "worker_pool.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <system_error>
+
+namespace {
+const uint32_t kCacheLine = 64;
+
+uint32_t Gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t rem = a % b;
+    a = b;
+    b = rem;
+  }
+  return a;
+}
+}
+
+WorkerPool::WorkerPool(uint32_t threads)
+    : threads_(threads == 0 ? 1 : threads),
+      states_(nullptr),
+      task_(nullptr),
+      generation_(0),
+      pending_(0),
+      stop_(false) {
+  void *buffer = nullptr;
+  if (posix_memalign(&buffer, kCacheLine, sizeof(WorkerState) * threads_)
+      != 0) {
+    throw std::bad_alloc();
+  }
+  states_ = static_cast<WorkerState *>(buffer);
+  for (uint32_t index = 0; index < threads_; ++index) {
+    new (&states_[index]) WorkerState();
+  }
+  for (uint32_t index = 1; index < threads_; ++index) {
+    try {
+      workers_.emplace_back(&WorkerPool::Work, this, index);
+    } catch (const std::system_error &) {
+      // run with the threads that started, their bands cover all rows
+      threads_ = index;
+      break;
+    }
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  free(states_);
+}
+
+void WorkerPool::Run(uint32_t rows, uint32_t row_bytes, const Task &task) {
+  // rows per cache line aligned edge, coarse edges only while bands stay
+  // balanced within a quarter
+  uint32_t granule = kCacheLine / Gcd(row_bytes, kCacheLine);
+  if (granule * threads_ * 4 > rows) {
+    granule = 1;
+  }
+  uint32_t units = (rows + granule - 1) / granule;
+  for (uint32_t index = 0; index < threads_; ++index) {
+    uint32_t begin = units * index / threads_ * granule;
+    uint32_t end = units * (index + 1) / threads_ * granule;
+    states_[index].begin = begin < rows ? begin : rows;
+    states_[index].end = end < rows ? end : rows;
+  }
+  if (threads_ == 1) {
+    task_ = &task;
+    RunBand(0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    pending_ = threads_ - 1;
+    ++generation_;
+  }
+  start_cv_.notify_all();
+  RunBand(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void WorkerPool::RunBand(uint32_t index) {
+  WorkerState &state = states_[index];
+  if (state.begin >= state.end) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  (*task_)(index, state.begin, state.end);
+  state.busy_ms += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  state.rows += state.end - state.begin;
+}
+
+void WorkerPool::Work(uint32_t index) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [this, seen] {
+        return stop_ || generation_ != seen;
+      });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+    RunBand(index);
+    bool last = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last = (--pending_ == 0);
+    }
+    if (last) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+std::string WorkerPool::ToString() const {
+  std::stringstream sstream;
+  sstream << "threads " << threads_;
+  for (uint32_t index = 0; index < threads_; ++index) {
+    sstream << ", [" << index << "] rows " << states_[index].rows
+            << " busy " << states_[index].busy_ms << "ms";
+  }
+  return sstream.str();
+}
@@ -0,0 +1,118 @@
+/**
+ * ============================================================================
+ *
+ * Copyright (C) 2018, Hisilicon Technologies Co., Ltd. All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1 Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *   2 Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *   3 Neither the names of the copyright holders nor the names of the
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * ============================================================================
+ */
+
+#ifndef GENERAL_POST_WORKER_POOL_H_
+#define GENERAL_POST_WORKER_POOL_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief: persistent threads running a row-band task; the caller thread
+ *         takes the first band, so a pool of 1 thread runs inline
+ */
+class WorkerPool {
+public:
+  /**
+   * @brief: task over rows [begin, end) on thread worker (0 is caller)
+   */
+  typedef std::function<void(uint32_t worker, uint32_t begin,
+                             uint32_t end)> Task;
+
+  /**
+   * @brief: constructor
+   * @param [in]: threads: threads including the caller, at least 1;
+   *              fewer run when threads can not be created. Throws
+   *              std::bad_alloc when thread states can not be allocated
+   */
+  explicit WorkerPool(uint32_t threads);
+
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /**
+   * @brief: threads including the caller
+   */
+  uint32_t Threads() const {
+    return threads_;
+  }
+
+  /**
+   * @brief: split rows in bands, one per thread, and wait for all of them.
+   *         Band edges fall on cache line boundaries of the output when
+   *         the row size allows it, so bands never write the same line
+   * @param [in]: rows: rows of output
+   * @param [in]: row_bytes: bytes per output row
+   * @param [in]: task: band task
+   */
+  void Run(uint32_t rows, uint32_t row_bytes, const Task &task);
+
+  /**
+   * @brief: per thread rows and busy time since start
+   */
+  std::string ToString() const;
+
+private:
+  // one cache line per thread, written by its owner only
+  struct alignas(64) WorkerState {
+    uint32_t begin;
+    uint32_t end;
+    uint64_t rows;
+    double busy_ms;
+  };
+
+  void Work(uint32_t index);
+
+  void RunBand(uint32_t index);
+
+  uint32_t threads_;
+  WorkerState *states_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const Task *task_;
+  uint64_t generation_;
+  uint32_t pending_;
+  bool stop_;
+};
+
+#endif /* GENERAL_POST_WORKER_POOL_H_ */